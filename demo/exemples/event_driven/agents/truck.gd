@@ -0,0 +1,18 @@
+extends GDAgent
+class_name TruckAgent
+
+
+# Number of deliveries done
+var deliveries := 0
+
+
+# Constructor
+func _init(new_label: String) -> void:
+	label = new_label
+
+
+# Each event is the end of a delivery, the next one takes a random time
+func _default_action(_delta: float) -> void:
+	if get_environment().get_time() > 0.0:
+		deliveries += 1
+	schedule_action(randf_range(0.5, 5.0))
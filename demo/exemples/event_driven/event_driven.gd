@@ -0,0 +1,28 @@
+extends GDEnvironment
+class_name EventDrivenEnvironment
+
+
+# Simulated duration
+@export var duration := 1000.0
+
+# Number of trucks
+@export var truck_count := 100
+
+
+# Called when the node enters the scene tree for the first time
+func _ready() -> void:
+	set_process(false)
+	set_physics_process(false)
+	for i in range(truck_count):
+		add(TruckAgent.new("Truck " + str(i + 1)))
+
+	var start_time := Time.get_ticks_msec()
+	var instants := run_until(duration)
+	var elapsed_time := Time.get_ticks_msec() - start_time
+
+	var deliveries := 0
+	for truck in get_children():
+		if truck is TruckAgent:
+			deliveries += truck.deliveries
+	print(str(instants) + " instants, " + str(deliveries) + " deliveries until t=" + str(get_time()))
+	print(str(elapsed_time) + " ms")
@@ -5,6 +5,7 @@ class_name WriterAgent
 # Constructor
 func _init(new_label: String) -> void:
 	label = new_label
+	is_message_driven = true # Only runs when a message arrives
 
 
 # Message received
@@ -0,0 +1,7 @@
+extends GDAgent
+class_name HookAgent
+
+
+# Compute action if there is no message (one script call per turn).
+func _default_action(_delta: float) -> void:
+	pass
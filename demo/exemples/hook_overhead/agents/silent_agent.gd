@@ -0,0 +1,4 @@
+extends GDAgent
+class_name SilentAgent
+
+# No hook: the environment never calls into the script
@@ -0,0 +1,47 @@
+extends GDEnvironment
+class_name HookOverheadEnvironment
+
+
+# Number of turns per trial
+@export var max_turns := 1000
+
+# Number agent
+@export var agent_count := 1000
+
+# Trial max
+var trial_max := 5
+
+
+# Called when the node enters the scene tree for the first time
+func _ready() -> void:
+	set_process(false)
+	set_physics_process(false)
+	var silent_time := run_trials(SilentAgent)
+	var hook_time := run_trials(HookAgent)
+	var calls := float(agent_count * max_turns)
+	print("Without hooks: " + str(silent_time * 1000.0 / calls) + " us/agent turn")
+	print("With hooks: " + str(hook_time * 1000.0 / calls) + " us/agent turn")
+	print("Per-call overhead: " + str((hook_time - silent_time) * 1000.0 / calls) + " us/call")
+
+
+# Average time (ms) of one trial with the given agents
+func run_trials(agent_type: GDScript) -> float:
+	var agents: Array[GDAgent] = []
+	for _i in range(agent_count):
+		agents.append(agent_type.new())
+		add(agents.back())
+	one_turn(0) # setup
+
+	var sum := 0.0
+	for trial in range(trial_max):
+		var start_time := Time.get_ticks_usec()
+		for _turn in range(max_turns):
+			one_turn(0)
+		var elapsed_time := (Time.get_ticks_usec() - start_time) / 1000.0
+		print(agent_type.get_global_name() + " trial " + str(trial + 1) + ": " + str(elapsed_time) + " ms")
+		sum += elapsed_time
+
+	for agent in agents:
+		agent.stop()
+	one_turn(0) # removal
+	return sum / trial_max
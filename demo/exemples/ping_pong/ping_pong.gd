@@ -42,8 +42,7 @@ func start_trial(trial: int) -> void:
 	message_count = 0
 	
 	_start_time = Time.get_ticks_msec()
-	for _turn in range(max_turns):
-		one_turn(Time.get_ticks_msec() - _start_time)
+	run_turns(max_turns)
 	var elapsed_time := Time.get_ticks_msec() - _start_time
 	
 	print(str(message_count) + " messages")
@@ -13,39 +13,28 @@ var type: AgentType:
 		type = new_type
 	get:
 		return type
-var grid_size := 50
-var position := Vector2():
-	set(new_position):
-		position = new_position
-		set_sprite_position(Vector2(int(new_position.x * CELL_SIZE + (CELL_SIZE / 2.0)), int(new_position.y * CELL_SIZE + (CELL_SIZE / 2.0))))
-	get:
-		return position
-var _turn_alive := 0
 var _environment: PredatorPreyEnvironment
 
 
 func _ready() -> void:
 	_environment = get_environment()
 	observables["type"] = type
+	stopped.connect(set_sprite_visible.bind(false))
 
 
 func _default_action(_delta: float) -> void:
-	_turn_alive += 1
+	set_sprite_position(spatial_position)
 	call("_agent_action")
 
 
 func die() -> void:
-	get_environment().remove_agent(self)
+	_environment.request_removal(self)
 
 
-func set_sprite_position(new_position: Vector2) -> void:
-	$Sprite.position = new_position
+# Deferred: agents may run on worker threads
+func set_sprite_position(cell: Vector2) -> void:
+	$Sprite.set_deferred("position", cell * CELL_SIZE + Vector2(CELL_SIZE / 2.0, CELL_SIZE / 2.0))
 
 
 func set_sprite_visible(visible: bool) -> void:
-	$Sprite.visible = false
-
-
-func remove() -> void:
-	set_sprite_visible(false)
-	stop()
+	$Sprite.set_deferred("visible", visible)
@@ -2,29 +2,38 @@ class_name AgentPredator
 extends AgentBase
 
 
-var _turn_starving := 0
+const BREEDING_TURNS := 8
+const STARVING_TURNS := 3
+
+
+var _starving_timer := 0
 
 
 func _init() -> void:
 	type = AgentType.PREDATOR
+	set_perception_filter("type == PREY", {"PREY": AgentType.PREY})
+
+
+func _setup() -> void:
+	set_timer(BREEDING_TURNS)
+	_starving_timer = set_timer(STARVING_TURNS)
+
+
+func _timer(_delta: float, timer_id: int) -> void:
+	if timer_id == _starving_timer:
+		die()
+	else:
+		_environment.random_bread(self)
+		set_timer(BREEDING_TURNS)
 
 
 func _agent_action() -> void:
-	_turn_starving += 1
-	var observables_seen := see()
+	var observables_seen := see(1.5) # eight neighbors
 	if not observables_seen.is_empty():
 		var ids := observables_seen.keys()
 		var random_id: String = ids[randi_range(0, ids.size() - 1)]
 		_environment.eat(self, random_id)
-		_turn_starving = 0
+		cancel_timer(_starving_timer)
+		_starving_timer = set_timer(STARVING_TURNS)
 	else:
 		_environment.random_move(self)
-	if _turn_alive >= 8:
-		_turn_alive = 0
-		_environment.random_bread(self)
-	if _turn_starving >= 3:
-		die()
-
-
-func _perception_filter(observables_seen: Dictionary) -> bool:
-	return observables_seen["type"] == AgentType.PREY
@@ -2,14 +2,21 @@ class_name AgentPrey
 extends AgentBase
 
 
+const BREEDING_TURNS := 2
+
+
 func _init() -> void:
 	type = AgentType.PREY
 
 
+func _setup() -> void:
+	set_timer(BREEDING_TURNS)
+
+
+func _timer(_delta: float, _timer_id: int) -> void:
+	_environment.random_bread(self)
+	set_timer(BREEDING_TURNS)
+
+
 func _agent_action() -> void:
-	_turn_alive += 1
 	_environment.random_move(self)
-	if _turn_alive >= 3:
-		_turn_alive = 0
-		_environment.random_bread(self)
-
@@ -0,0 +1,178 @@
+/**************************************************************************
+ *                                                                        *
+ *  Description: MinimalAgent multi-agent framework                       *
+ *  Website:     https://github.com/jferdelyi/MinimalAgent                *
+ *  Copyright:   (c) 2023-Today, Jean-François Erdelyi                    *
+ *                                                                        *
+ *  CPP version of ActressMAS by Florin Leon                              *
+ *  https://github.com/florinleon/ActressMas                              *
+ *                                                                        *
+ *  This program is free software; you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General License as published by         *
+ *  the Free Software Foundation. This program is distributed in the      *
+ *  hope that it will be useful, but WITHOUT ANY WARRANTY; without even   *
+ *  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR   *
+ *  PURPOSE. See the GNU General License for more details.                *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Online choice between running the agents of a turn on the calling thread or
+ * on the workers (Auto mode), and of the chunk size.
+ *
+ * Each turn reports its agent count, its wall time and the time spent in the
+ * agents (work). The model keeps two moving averages: the cost of one agent
+ * (work / count) and the dispatch overhead of a parallel turn (wall - work /
+ * workers). The predicted times are count * cost sequentially and overhead +
+ * count * cost / workers in parallel. The decision only flips when the other
+ * side is predicted faster by a margin and after a minimum number of turns, so
+ * it does not flap around the break-even point. A long sequential streak is
+ * interrupted by one parallel turn to refresh the overhead estimate.
+ */
+class AdaptiveDispatch final {
+public:
+    /**
+     * Decision for one turn.
+     */
+    struct Decision {
+        bool m_is_parallel = false;
+        size_t m_grain = 1;
+    };
+
+private:
+    /**
+     * Weight of the last turn in the moving averages
+     */
+    static constexpr double s_smoothing = 0.125;
+
+    /**
+     * Predicted gain needed to switch (fraction of the current prediction)
+     */
+    static constexpr double s_hysteresis = 0.25;
+
+    /**
+     * Turns between two switches
+     */
+    static constexpr uint32_t s_min_dwell = 16;
+
+    /**
+     * Sequential turns before a parallel probe
+     */
+    static constexpr uint32_t s_probe_period = 256;
+
+    /**
+     * Work aimed for in one chunk (ns), a few times the cost of handing out a chunk
+     */
+    static constexpr double s_chunk_work = 20000.0;
+
+    /**
+     * Average cost of one agent (ns), 0 until the first turn
+     */
+    double m_agent_cost = 0.0;
+
+    /**
+     * Average overhead of a parallel turn (ns), starts with a rough prior
+     */
+    double m_overhead = 20000.0;
+
+    /**
+     * Current side, turns since the last switch and since the last parallel turn
+     */
+    bool m_is_parallel = false;
+    uint32_t m_dwell = s_min_dwell;
+    uint32_t m_sequential_turns = 0;
+
+    /**
+     * Last chunk size and number of switches
+     */
+    size_t m_grain = 1;
+    uint64_t m_switch_count = 0;
+
+public:
+    /**
+     * Choose how to run the next turn.
+     * @param p_count number of agents to run
+     * @param p_workers number of workers available, calling thread included
+     * @return decision
+     */
+    Decision decide(const size_t p_count, const size_t p_workers) {
+        if (p_workers <= 1 || p_count < 2) {
+            return {false, std::max<size_t>(p_count, 1)};
+        }
+
+        // Switch only on a clear predicted gain
+        if (m_dwell < s_min_dwell) {
+            ++m_dwell;
+        } else if (m_agent_cost > 0.0) {
+            const double l_sequential = static_cast<double>(p_count) * m_agent_cost;
+            const double l_parallel = m_overhead + l_sequential / static_cast<double>(p_workers);
+            const bool l_is_parallel = m_is_parallel ? l_sequential >= l_parallel * (1.0 - s_hysteresis) : l_parallel < l_sequential * (1.0 - s_hysteresis);
+            if (l_is_parallel != m_is_parallel) {
+                m_is_parallel = l_is_parallel;
+                m_dwell = 0;
+                ++m_switch_count;
+            }
+        }
+
+        bool l_is_parallel = m_is_parallel;
+        if (l_is_parallel) {
+            m_sequential_turns = 0;
+        } else if (++m_sequential_turns >= s_probe_period) {
+            m_sequential_turns = 0;
+            l_is_parallel = true;
+        }
+
+        // Chunks worth handing out, but enough of them to balance the workers
+        const double l_chunk = std::ceil(s_chunk_work / std::max(m_agent_cost, 1.0));
+        const size_t l_balanced = std::max<size_t>(1, p_count / (p_workers * 4));
+        m_grain = std::clamp(static_cast<size_t>(l_chunk), size_t(1), l_balanced);
+        return {l_is_parallel, m_grain};
+    }
+
+    /**
+     * Report a turn.
+     * @param p_count number of agents run
+     * @param p_workers number of workers available, calling thread included
+     * @param p_is_parallel true if the turn ran on the workers
+     * @param p_wall wall time of the turn (ns)
+     * @param p_work time spent in the agents, all threads (ns)
+     */
+    void record(const size_t p_count, const size_t p_workers, const bool p_is_parallel, const uint64_t p_wall, const uint64_t p_work) {
+        if (p_count == 0) {
+            return;
+        }
+        const double l_agent_cost = static_cast<double>(p_work) / static_cast<double>(p_count);
+        m_agent_cost = m_agent_cost == 0.0 ? l_agent_cost : m_agent_cost + s_smoothing * (l_agent_cost - m_agent_cost);
+        if (p_is_parallel && p_workers > 1) {
+            const double l_overhead = std::max(0.0, static_cast<double>(p_wall) - static_cast<double>(p_work) / static_cast<double>(p_workers));
+            m_overhead += s_smoothing * (l_overhead - m_overhead);
+        }
+    }
+
+    [[nodiscard]] bool is_parallel() const {
+        return m_is_parallel;
+    }
+
+    [[nodiscard]] size_t get_grain() const {
+        return m_grain;
+    }
+
+    [[nodiscard]] double get_agent_cost() const {
+        return m_agent_cost;
+    }
+
+    [[nodiscard]] double get_overhead() const {
+        return m_overhead;
+    }
+
+    [[nodiscard]] uint64_t get_switch_count() const {
+        return m_switch_count;
+    }
+};
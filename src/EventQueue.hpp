@@ -0,0 +1,125 @@
+/**************************************************************************
+ *                                                                        *
+ *  Description: MinimalAgent multi-agent framework                       *
+ *  Website:     https://github.com/jferdelyi/MinimalAgent                *
+ *  Copyright:   (c) 2023-Today, Jean-François Erdelyi                    *
+ *                                                                        *
+ *  CPP version of ActressMAS by Florin Leon                              *
+ *  https://github.com/florinleon/ActressMas                              *
+ *                                                                        *
+ *  This program is free software; you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General License as published by         *
+ *  the Free Software Foundation. This program is distributed in the      *
+ *  hope that it will be useful, but WITHOUT ANY WARRANTY; without even   *
+ *  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR   *
+ *  PURPOSE. See the GNU General License for more details.                *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * Priority queue of events (smallest first) stored as an implicit d-ary heap.
+ *
+ * With 4 children per node the heap is half as deep as a binary heap and the
+ * children of a node share one or two cache lines, so pops (the hot operation of
+ * an event-driven simulation) touch fewer lines. Events only need operator<,
+ * which must be a strict total order for a deterministic pop order.
+ */
+template<typename T, std::size_t D = 4>
+class EventQueue final {
+    static_assert(D >= 2, "EventQueue needs at least 2 children per node");
+
+    /**
+     * Heap storage
+     */
+    std::vector<T> m_items;
+
+public:
+    /**
+     * Add an event.
+     * @param p_event Event
+     */
+    void push(T p_event) {
+        m_items.push_back(std::move(p_event));
+        sift_up(m_items.size() - 1);
+    }
+
+    /**
+     * Smallest event, the queue must not be empty.
+     * @return event
+     */
+    [[nodiscard]] const T& top() const {
+        return m_items.front();
+    }
+
+    /**
+     * Remove the smallest event, the queue must not be empty.
+     * @return event
+     */
+    T pop() {
+        T l_top = std::move(m_items.front());
+        if (m_items.size() > 1) {
+            m_items.front() = std::move(m_items.back());
+            m_items.pop_back();
+            sift_down(0);
+        } else {
+            m_items.pop_back();
+        }
+        return l_top;
+    }
+
+    [[nodiscard]] bool is_empty() const {
+        return m_items.empty();
+    }
+
+    [[nodiscard]] std::size_t size() const {
+        return m_items.size();
+    }
+
+    void clear() {
+        m_items.clear();
+    }
+
+private:
+    void sift_up(std::size_t p_index) {
+        T l_item = std::move(m_items[p_index]);
+        while (p_index > 0) {
+            const std::size_t l_parent = (p_index - 1) / D;
+            if (!(l_item < m_items[l_parent])) {
+                break;
+            }
+            m_items[p_index] = std::move(m_items[l_parent]);
+            p_index = l_parent;
+        }
+        m_items[p_index] = std::move(l_item);
+    }
+
+    void sift_down(std::size_t p_index) {
+        const std::size_t l_size = m_items.size();
+        T l_item = std::move(m_items[p_index]);
+        for (;;) {
+            const std::size_t l_first = p_index * D + 1;
+            if (l_first >= l_size) {
+                break;
+            }
+            const std::size_t l_last = l_first + D < l_size ? l_first + D : l_size;
+            std::size_t l_smallest = l_first;
+            for (std::size_t l_child = l_first + 1; l_child < l_last; ++l_child) {
+                if (m_items[l_child] < m_items[l_smallest]) {
+                    l_smallest = l_child;
+                }
+            }
+            if (!(m_items[l_smallest] < l_item)) {
+                break;
+            }
+            m_items[p_index] = std::move(m_items[l_smallest]);
+            p_index = l_smallest;
+        }
+        m_items[p_index] = std::move(l_item);
+    }
+};
@@ -1,5 +1,7 @@
 #include "GDAgent.h"
 
+#include <algorithm>
+
 #include <godot_cpp/core/class_db.hpp>
 
 #include <uuid/UUID.hpp>
@@ -8,6 +10,32 @@
 
 using namespace godot;
 
+namespace {
+    /**
+     * Agent running its turn on this thread.
+     **/
+    thread_local GDAgent* s_running_agent = nullptr;
+
+    /**
+     * Mark an agent as running for the scope.
+     **/
+    class RunningAgentScope final {
+        GDAgent* m_previous;
+
+    public:
+        explicit RunningAgentScope(GDAgent* p_agent) :
+                m_previous(s_running_agent) {
+            s_running_agent = p_agent;
+        }
+
+        ~RunningAgentScope() {
+            s_running_agent = m_previous;
+        }
+    };
+}
+
+std::array<StringName, GDAgent::HOOK_COUNT>* GDAgent::s_hook_names = nullptr;
+
 GDAgent::GDAgent() {
     m_id = String(UUID::generate_uuid().c_str());
 }
@@ -21,7 +49,9 @@ void GDAgent::_bind_methods() {
     ClassDB::bind_method(D_METHOD("is_setup"), &GDAgent::is_setup);
     ClassDB::bind_method(D_METHOD("is_dead"), &GDAgent::is_dead);
     ClassDB::bind_method(D_METHOD("stop"), &GDAgent::stop);
+    ClassDB::bind_method(D_METHOD("wake"), &GDAgent::wake);
     ClassDB::bind_method(D_METHOD("get_id"), &GDAgent::get_id);
+    ClassDB::bind_method(D_METHOD("get_handle"), &GDAgent::get_agent_handle);
 
     ClassDB::bind_method(D_METHOD("add"), &GDAgent::add);
     ClassDB::bind_method(D_METHOD("agents_count"), &GDAgent::agents_count);
@@ -31,9 +61,14 @@ void GDAgent::_bind_methods() {
     ClassDB::bind_method(D_METHOD("get_agent_label"), &GDAgent::get_agent_label);
 
     ClassDB::bind_method(D_METHOD("send"), &GDAgent::send);
+    ClassDB::bind_method(D_METHOD("send_handle"), &GDAgent::send_handle);
     ClassDB::bind_method(D_METHOD("send_by_label"), &GDAgent::send_by_label);
     ClassDB::bind_method(D_METHOD("send_by_fragment_label"), &GDAgent::send_by_fragment_label);
     ClassDB::bind_method(D_METHOD("broadcast"), &GDAgent::broadcast);
+    ClassDB::bind_method(D_METHOD("set_timer"), &GDAgent::set_timer);
+    ClassDB::bind_method(D_METHOD("send_delayed"), &GDAgent::send_delayed);
+    ClassDB::bind_method(D_METHOD("cancel_timer"), &GDAgent::cancel_timer);
+    ClassDB::bind_method(D_METHOD("schedule_action"), &GDAgent::schedule_action);
     ClassDB::bind_method(D_METHOD("get_environment"), &GDAgent::get_environment);
 
     ClassDB::bind_method(D_METHOD("randi"), &GDAgent::randi);
@@ -42,6 +77,8 @@ void GDAgent::_bind_methods() {
     ClassDB::bind_method(D_METHOD("randf_range"), &GDAgent::randf_range);
 
     ClassDB::bind_method(D_METHOD("see"), &GDAgent::see, DEFVAL(""));
+    ClassDB::bind_method(D_METHOD("set_perception_filter", "expression", "constants"), &GDAgent::set_perception_filter, DEFVAL(Dictionary()));
+    ClassDB::bind_method(D_METHOD("has_perception_filter"), &GDAgent::has_perception_filter);
 
     // Properties
     ClassDB::bind_method(D_METHOD("set_label"), &GDAgent::set_label);
@@ -62,6 +99,29 @@ void GDAgent::_bind_methods() {
     //        "get_can_see"
     //);
 
+    ClassDB::bind_method(D_METHOD("set_observable"), &GDAgent::set_observable);
+    ClassDB::bind_method(D_METHOD("get_observable"), &GDAgent::get_observable);
+
+    ClassDB::bind_method(D_METHOD("get_run_cost_usec"), &GDAgent::get_run_cost_usec);
+
+    ClassDB::bind_method(D_METHOD("set_spatial_position"), &GDAgent::set_spatial_position);
+    ClassDB::bind_method(D_METHOD("get_spatial_position"), &GDAgent::get_spatial_position);
+    ClassDB::add_property(
+            "GDAgent",
+            PropertyInfo(Variant::VECTOR2, "spatial_position", PROPERTY_HINT_NONE, "Agent position in the environment spatial index"),
+            "set_spatial_position",
+            "get_spatial_position"
+    );
+
+    ClassDB::bind_method(D_METHOD("set_message_driven"), &GDAgent::set_message_driven);
+    ClassDB::bind_method(D_METHOD("get_message_driven"), &GDAgent::get_message_driven);
+    ClassDB::add_property(
+            "GDAgent",
+            PropertyInfo(Variant::BOOL, "is_message_driven", PROPERTY_HINT_NONE, "If true, the agent only runs when it receives a message or is woken up"),
+            "set_message_driven",
+            "get_message_driven"
+    );
+
     ClassDB::bind_method(D_METHOD("set_observables"), &GDAgent::set_observables);
     ClassDB::bind_method(D_METHOD("get_observables"), &GDAgent::get_observables);
     ClassDB::add_property(
@@ -87,10 +147,15 @@ void GDAgent::run_turn(float p_elapsed_time, bool p_run_setup_separately) {
     if (is_dead()) {
         return;
     }
+    RunningAgentScope l_running_scope(this);
 
     if (p_run_setup_separately) {
         if (!is_setup()) {
             setup();
+            // Messages received before or during setup are read next turn
+            if (m_is_message_driven) {
+                add_wake_reason(WAKE_MESSAGE);
+            }
         } else {
             //if (m_can_see) {
             //    see();
@@ -98,11 +163,14 @@ void GDAgent::run_turn(float p_elapsed_time, bool p_run_setup_separately) {
             if (is_dead()) {
                 return;
             }
+            timers(p_elapsed_time);
             action(p_elapsed_time);
         }
 
     } else {
-        setup();
+        if (!is_setup()) {
+            setup();
+        }
         if (is_dead()) {
             return;
         }
@@ -112,10 +180,88 @@ void GDAgent::run_turn(float p_elapsed_time, bool p_run_setup_separately) {
         if (is_dead()) {
             return;
         }
+        timers(p_elapsed_time);
         action(p_elapsed_time);
     }
 }
 
+void GDAgent::initialize_hook_names() {
+    if (!s_hook_names) {
+        s_hook_names = new std::array<StringName, HOOK_COUNT>{
+                StringName("_setup"),
+                StringName("_action"),
+                StringName("_action_batch"),
+                StringName("_default_action"),
+                StringName("_perception_filter"),
+                StringName("_timer")
+        };
+    }
+}
+
+void GDAgent::release_hook_names() {
+    delete s_hook_names;
+    s_hook_names = nullptr;
+}
+
+void GDAgent::resolve_hooks() {
+    m_hooks = 0;
+    for (uint32_t l_hook = 0; l_hook < HOOK_COUNT; ++l_hook) {
+        if (has_method((*s_hook_names)[l_hook])) {
+            m_hooks |= 1u << l_hook;
+            m_hook_calls[l_hook] = Callable(this, (*s_hook_names)[l_hook]);
+        } else {
+            m_hook_calls[l_hook] = Callable();
+        }
+    }
+}
+
+bool GDAgent::perception_filter(const Dictionary& p_observed) {
+    if (!has_hook(HOOK_PERCEPTION_FILTER)) {
+        return false;
+    }
+    return call_hook(HOOK_PERCEPTION_FILTER, p_observed);
+}
+
+bool GDAgent::set_perception_filter(const String& p_expression, const Dictionary& p_constants) {
+    m_perception_filter.clear();
+    m_perception_filter_keys.clear();
+    m_perception_filter_fields.clear();
+    m_perception_filter_schema_size = 0;
+    if (p_expression.is_empty()) {
+        return true;
+    }
+
+    std::string l_error;
+    const bool l_is_valid = m_perception_filter.compile(p_expression.utf8().get_data(), [&p_constants](const std::string& p_name) -> std::optional<double> {
+        const Variant l_value = p_constants.get(String(p_name.c_str()), Variant());
+        if (l_value.get_type() != Variant::INT && l_value.get_type() != Variant::FLOAT && l_value.get_type() != Variant::BOOL) {
+            return std::nullopt;
+        }
+        return static_cast<double>(l_value);
+    }, l_error);
+    if (!l_is_valid) {
+        UtilityFunctions::push_error("Invalid perception filter \"", p_expression, "\": ", String(l_error.c_str()));
+        return false;
+    }
+
+    for (const std::string& l_name: m_perception_filter.get_observables()) {
+        m_perception_filter_keys.emplace_back(l_name.c_str());
+    }
+    return true;
+}
+
+const std::vector<uint32_t>& GDAgent::get_perception_filter_fields(const ObservableColumns& p_columns) {
+    // The schema only grows
+    if (m_perception_filter_fields.empty() || m_perception_filter_schema_size != p_columns.field_count()) {
+        m_perception_filter_schema_size = p_columns.field_count();
+        m_perception_filter_fields.clear();
+        for (const std::string& l_name: m_perception_filter.get_observables()) {
+            m_perception_filter_fields.push_back(p_columns.find_field(l_name));
+        }
+    }
+    return m_perception_filter_fields;
+}
+
 int GDAgent::agents_count() const {
     return static_cast<int>(m_environment->agents_count());
 }
@@ -144,36 +290,163 @@ Variant GDAgent::get_agent_label(const String& p_id) const {
     return {};
 }
 
+int64_t GDAgent::set_timer(const int p_turns) const {
+    return m_environment ? m_environment->set_timer(m_handle, p_turns) : 0;
+}
+
+int64_t GDAgent::send_delayed(const String& p_receiver_id, const String& p_message, const int p_turns) const {
+    return m_environment ? m_environment->send_delayed(m_id, p_receiver_id, p_message, p_turns, next_order()) : 0;
+}
+
+void GDAgent::cancel_timer(const int64_t p_id) const {
+    if (m_environment) {
+        m_environment->cancel_timer(p_id);
+    }
+}
+
+void GDAgent::schedule_action(const double p_delay) const {
+    if (m_environment) {
+        m_environment->schedule_event(m_handle, p_delay);
+    }
+}
+
 void GDAgent::send(const String& p_receiver_id, const String& p_message) const {
-    m_environment->send(m_id, p_receiver_id, p_message);
+    m_environment->send(m_id, p_receiver_id, p_message, next_order());
+}
+
+void GDAgent::send_handle(const int64_t p_receiver_handle, const String& p_message) const {
+    m_environment->send(m_id, static_cast<AgentHandle>(p_receiver_handle), p_message, next_order());
 }
 
 void GDAgent::send_by_label(const String& p_receiver_label, const String& p_message, bool p_first_only) const {
-    m_environment->send_by_label(m_id, p_receiver_label, p_message, false, p_first_only);
+    m_environment->send_by_label(m_id, p_receiver_label, p_message, false, p_first_only, next_order());
 }
 
 void GDAgent::send_by_fragment_label(const String& p_fragment_label, const String& p_message, bool p_first_only) const {
-    m_environment->send_by_label(m_id, p_fragment_label, p_message, true, p_first_only);
+    m_environment->send_by_label(m_id, p_fragment_label, p_message, true, p_first_only, next_order());
 }
 
 void GDAgent::broadcast(const String& p_message) const {
-    m_environment->broadcast(m_id, p_message);
+    m_environment->broadcast(m_id, p_message, next_order());
+}
+
+void GDAgent::set_spatial_position(const Vector2& p_spatial_position) {
+    m_spatial_position = p_spatial_position;
+    m_is_placed = true;
+    if (m_environment && m_handle != 0) {
+        m_environment->move_agent(m_handle, p_spatial_position);
+    }
+}
+
+bool GDAgent::set_observable(const String& p_name, const Variant& p_value) const {
+    return m_environment && m_environment->set_observable(m_handle, p_name, p_value);
+}
+
+Variant GDAgent::get_observable(const String& p_name) const {
+    if (!m_environment) {
+        return {};
+    }
+    return m_environment->get_observable(m_handle, p_name);
+}
+
+void GDAgent::publish_observables() {
+    // Unchanged observables keep their snapshot (no copy, no allocation)
+    if (m_observables.is_empty()) {
+        if (!m_published_observables.is_empty()) {
+            m_published_observables = Dictionary();
+        }
+        return;
+    }
+    // Deep compare, deep copy: nested Arrays and Dictionaries edited in place during
+    // the turn must not be shared with the readers of the snapshot
+    if (m_published_observables == m_observables) {
+        return;
+    }
+    m_published_observables = m_observables.duplicate(true);
+    m_published_observables.make_read_only();
+}
+
+void GDAgent::swap_mailboxes() {
+    // Nothing arrived (e.g. a sleeping agent)
+    if (m_messages.is_empty()) {
+        return;
+    }
+
+    // Messages not read yet (e.g. setup turn) stay first
+    const auto l_first_new = static_cast<std::ptrdiff_t>(m_inbox.size());
+    Message l_message;
+    while (m_messages.dequeue(l_message)) {
+        m_inbox.push_back(std::move(l_message));
+    }
+
+    // Arrival order depends on threads, the stamp does not (unique per receiver,
+    // so an in place sort is enough)
+    std::sort(m_inbox.begin() + l_first_new, m_inbox.end(), [](const Message& p_left, const Message& p_right) {
+        return p_left.get_order() < p_right.get_order();
+    });
+
+    // The wake-up of a message sent earlier in the previous turn may already be consumed
+    if (m_is_message_driven && static_cast<std::ptrdiff_t>(m_inbox.size()) != l_first_new) {
+        m_wake_reasons.fetch_or(WAKE_MESSAGE, std::memory_order_relaxed);
+    }
+}
+
+RandomStream& GDAgent::get_random_stream() {
+    if (m_environment) {
+        const int l_turn = m_environment->get_turn();
+        if (l_turn != m_random_turn) {
+            m_random_turn = l_turn;
+            m_random.reset(static_cast<uint32_t>(m_environment->get_seed()), m_random_stream_id, static_cast<uint32_t>(l_turn));
+        }
+    }
+    return m_random;
+}
+
+GDAgent* GDAgent::get_running_agent() {
+    return s_running_agent;
+}
+
+uint64_t GDAgent::next_order() const {
+    // Stamps restart every turn (only the agents that run issue any)
+    if (m_environment && m_environment->get_turn() != m_order_turn) {
+        m_order_turn = m_environment->get_turn();
+        m_order_count = 0;
+    }
+    return (static_cast<uint64_t>(m_schedule_index) << 32) | m_order_count++;
+}
+
+void GDAgent::request_run() {
+    if (m_environment && m_handle != 0 && !m_is_listed.load() && mark_listed()) {
+        m_environment->list_awake_agent(this);
+    }
+}
+
+void GDAgent::stop() {
+    if (m_is_dead.exchange(true)) {
+        return;
+    }
+    // Swept from the wake list at the next turn start
+    if (m_environment && m_handle != 0) {
+        m_environment->agent_stopped();
+        request_run();
+    }
+    call("emit_signal", "stopped");
 }
 
 unsigned int GDAgent::randi() {
-    return m_environment->randi();
+    return get_random_stream().next_u32();
 }
 
 int GDAgent::randi_range(int p_min, int p_max) {
-    return m_environment->randi_range(p_min, p_max);
+    return static_cast<int>(get_random_stream().range_int(p_min, p_max));
 }
 
 double GDAgent::randf() {
-    return m_environment->randf();
+    return get_random_stream().next_double();
 }
 
 double GDAgent::randf_range(double p_min, double p_max) {
-    return m_environment->randf_range(p_min, p_max);
+    return get_random_stream().range_double(p_min, p_max);
 }
 
 //###############################################################
@@ -184,7 +457,9 @@ void GDAgent::setup() {
     m_is_setup = true;
     //emit_signal("setup", this);
     //call_deferred("emit_signal", "setup", this);
-    call("_setup");
+    if (has_hook(HOOK_SETUP)) {
+        call_hook(HOOK_SETUP);
+    }
 }
 
 Dictionary GDAgent::see(const Variant& p_parameters) {
@@ -192,19 +467,90 @@ Dictionary GDAgent::see(const Variant& p_parameters) {
 }
 
 void GDAgent::action(float p_elapsed_time) {
-    if (MessagePointer l_message; m_messages.dequeue(l_message)) {
-        do {
-            //emit_signal("action", this, l_message->get_sender(), l_message->to_string());
-            //call_deferred("emit_signal", "action", this, l_message->get_sender(), l_message->to_string());
-            call("_action", p_elapsed_time, l_message->get_sender(), l_message->to_string());
-        } while (m_messages.dequeue(l_message));
-    } else {
+    if (has_hook(HOOK_ACTION_BATCH)) {
+        action_batch(p_elapsed_time);
+        return;
+    }
+
+    const bool l_has_hook = has_hook(HOOK_ACTION);
+    bool l_has_message = false;
+
+    // Delivered at the turn boundary
+    if (!m_inbox.empty()) {
+        l_has_message = true;
+        if (l_has_hook) {
+            for (const Message& l_message: m_inbox) {
+                call_hook(HOOK_ACTION, p_elapsed_time, l_message.get_sender(), l_message.to_string());
+            }
+        }
+        m_inbox.clear();
+    }
+
+    // Delivered as soon as sent
+    if (!m_environment->get_using_synchronous_delivery()) {
+        if (Message l_message; m_messages.dequeue(l_message)) {
+            l_has_message = true;
+            do {
+                //emit_signal("action", this, l_message.get_sender(), l_message.to_string());
+                //call_deferred("emit_signal", "action", this, l_message.get_sender(), l_message.to_string());
+                if (l_has_hook) {
+                    call_hook(HOOK_ACTION, p_elapsed_time, l_message.get_sender(), l_message.to_string());
+                }
+            } while (m_messages.dequeue(l_message));
+        }
+    }
+
+    if (!l_has_message) {
+        default_action(p_elapsed_time);
+    }
+}
+
+void GDAgent::action_batch(float p_elapsed_time) {
+    PackedStringArray l_senders;
+    PackedStringArray l_messages;
+
+    // Delivered at the turn boundary
+    for (const Message& l_message: m_inbox) {
+        l_senders.push_back(l_message.get_sender());
+        l_messages.push_back(l_message.to_string());
+    }
+    m_inbox.clear();
+
+    // Delivered as soon as sent
+    if (!m_environment->get_using_synchronous_delivery()) {
+        Message l_message;
+        while (m_messages.dequeue(l_message)) {
+            l_senders.push_back(l_message.get_sender());
+            l_messages.push_back(l_message.to_string());
+        }
+    }
+
+    if (l_senders.is_empty()) {
         default_action(p_elapsed_time);
+    } else {
+        call_hook(HOOK_ACTION_BATCH, p_elapsed_time, l_senders, l_messages);
+    }
+}
+
+void GDAgent::timers(float p_elapsed_time) {
+    if (m_fired_timers.empty()) {
+        return;
+    }
+    if (has_hook(HOOK_TIMER)) {
+        for (const int64_t l_id: m_fired_timers) {
+            call_hook(HOOK_TIMER, p_elapsed_time, l_id);
+        }
     }
+    m_fired_timers.clear();
 }
 
 void GDAgent::default_action(float p_elapsed_time) {
     //emit_signal("default_action", this);
     //call_deferred("emit_signal", "default_action", this);
-    call("_default_action", p_elapsed_time);
+    if (m_is_message_driven && !(m_turn_wake_reasons & WAKE_EXPLICIT)) {
+        return;
+    }
+    if (has_hook(HOOK_DEFAULT_ACTION)) {
+        call_hook(HOOK_DEFAULT_ACTION, p_elapsed_time);
+    }
 }
@@ -6,12 +6,16 @@
 #include <godot_cpp/core/binder_common.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
 
-#include <nlohmann/json.hpp>
+#include <array>
+#include <atomic>
 #include <utility>
-using json = nlohmann::json;
 
 #include "MPSCQueue.hpp"
 #include "Message.h"
+#include "ObservableColumns.hpp"
+#include "PerceptionFilter.h"
+#include "RandomStream.hpp"
+#include "SlotMap.hpp"
 
 using namespace godot;
 using namespace std;
@@ -21,12 +25,9 @@ namespace godot {
     class GDEnvironment;
 
     /**
-     * Represents the observable properties of an agent. They depend on the set of
-     * Observables properties of an agent and on the PerceptionFilter function of an
-     * agent who wants to observe other agents.
+     * Agent handle in its environment (generation-checked, see SlotMap).
      **/
-    using Observables = std::unordered_map<std::string, json>;
-    using ObservablesPointer = std::shared_ptr<const Observables>;
+    using AgentHandle = SlotHandle;
 
     /**
      * Godot Agent
@@ -34,8 +35,42 @@ namespace godot {
     class GDAgent : public Node {
     GDCLASS(GDAgent, Node)
 
+    public:
+        /**
+         * Script hooks called by the framework.
+         **/
+        enum Hook : uint32_t {
+            HOOK_SETUP,
+            HOOK_ACTION,
+            HOOK_ACTION_BATCH,
+            HOOK_DEFAULT_ACTION,
+            HOOK_PERCEPTION_FILTER,
+            HOOK_TIMER,
+            HOOK_COUNT
+        };
+
+        /**
+         * Why a message-driven agent runs this turn.
+         **/
+        enum WakeReason : uint8_t {
+            WAKE_MESSAGE = 1u << 0,
+            WAKE_EXPLICIT = 1u << 1,
+            WAKE_TIMER = 1u << 2
+        };
+
         // Private attributes
     private:
+        /**
+         * Hooks assumed before resolve_hooks (same calls as without the cache).
+         **/
+        static constexpr uint32_t s_unresolved_hooks =
+                (1u << HOOK_SETUP) | (1u << HOOK_ACTION) | (1u << HOOK_DEFAULT_ACTION) | (1u << HOOK_PERCEPTION_FILTER);
+
+        /**
+         * Hook names, built once (StringName can only exist while the extension is loaded).
+         **/
+        static std::array<StringName, HOOK_COUNT>* s_hook_names;
+
         // Exposed
 
         /**
@@ -44,10 +79,22 @@ namespace godot {
         String m_label = "Agent";
 
         /**
-         * List of observables.
+         * List of observables (back buffer, written during the turn).
          **/
         Dictionary m_observables = Dictionary();
 
+        /**
+         * Read-only deep copy of the observables published at the turn start (front
+         * buffer, read by the other agents).
+         **/
+        Dictionary m_published_observables = Dictionary();
+
+        /**
+         * If true, the agent only runs when woken up: a message posted to it or a
+         * call to wake (e.g. timers). "_default_action" is only called on wake.
+         **/
+        bool m_is_message_driven = false;
+
         /**
          * True if using observables.
          **/
@@ -61,6 +108,11 @@ namespace godot {
          **/
         String m_id = "-1";
 
+        /**
+         * Handle in the environment (0 until registered).
+         **/
+        AgentHandle m_handle = 0;
+
         /**
          * The environment where the agent is.
          **/
@@ -72,14 +124,111 @@ namespace godot {
         bool m_is_setup = false;
 
         /**
-         * True if dead.
+         * True if dead (set once, from any thread).
+         **/
+        std::atomic<bool> m_is_dead = false;
+
+        /**
+         * Messages arrived (back mailbox in synchronous delivery).
+         **/
+        MPSCQueue<Message> m_messages = MPSCQueue<Message>();
+
+        /**
+         * Messages delivered at the turn boundary (front mailbox in synchronous delivery).
+         **/
+        std::vector<Message> m_inbox = std::vector<Message>();
+
+        /**
+         * Wake-ups since the turn start (WakeReason bits, set from any thread) and
+         * the ones of the current turn.
+         **/
+        std::atomic<uint8_t> m_wake_reasons = 0;
+        uint8_t m_turn_wake_reasons = 0;
+
+        /**
+         * True while the agent is on the wake list of its environment: set by the first
+         * wake-up (no duplicates), cleared when a message-driven agent consumes its
+         * wake-ups. Agents that are not message-driven stay listed.
+         **/
+        std::atomic<bool> m_is_listed = false;
+
+        /**
+         * EventDriven: time of the last event run (negative before the first one),
+         * time elapsed since the previous one, instant of the last event run.
+         **/
+        double m_last_event_time = -1.0;
+        float m_event_elapsed_time = 0.0f;
+        uint64_t m_event_instant = UINT64_MAX;
+
+        /**
+         * Moving average of the run time of the agent (ns), 0 until measured (cost balancing).
+         **/
+        double m_run_cost = 0.0;
+
+        /**
+         * Timers fired for the next run of the agent ("_timer" hook).
+         **/
+        std::vector<int64_t> m_fired_timers = std::vector<int64_t>();
+
+        /**
+         * Hooks defined by the script, one bit per Hook.
+         **/
+        uint32_t m_hooks = s_unresolved_hooks;
+
+        /**
+         * Defined hooks bound once by resolve_hooks (invalid for the others and before it).
+         **/
+        std::array<Callable, HOOK_COUNT> m_hook_calls = std::array<Callable, HOOK_COUNT>();
+
+        /**
+         * Native perception filter (replaces "_perception_filter" when set), names of
+         * its observables and their typed field IDs for the current schema size.
+         **/
+        PerceptionFilter m_perception_filter = PerceptionFilter();
+        std::vector<String> m_perception_filter_keys = std::vector<String>();
+        std::vector<uint32_t> m_perception_filter_fields = std::vector<uint32_t>();
+        size_t m_perception_filter_schema_size = 0;
+
+        /**
+         * Position in the spatial index, only if placed.
+         **/
+        Vector2 m_spatial_position = Vector2();
+        bool m_is_placed = false;
+
+        /**
+         * Registration rank of the agent in the environment (scheduling order).
+         **/
+        uint32_t m_schedule_index = 0;
+
+        /**
+         * Messages and intents issued during the turn m_order_turn (stamps restart every turn).
          **/
-        bool m_is_dead = false;
+        mutable uint32_t m_order_count = 0;
+        mutable int m_order_turn = -1;
 
         /**
-         * Messages arrived.
+         * Random stream, keyed by the environment seed, the stream ID and the turn.
          **/
-        MPSCQueue<MessagePointer> m_messages = MPSCQueue<MessagePointer>();
+        RandomStream m_random = RandomStream();
+        uint32_t m_random_stream_id = 0;
+        int m_random_turn = -1;
+
+        /**
+         * Add wake-up reasons and put the agent on the wake list (any thread).
+         * @param p_reasons WAKE_* flags
+         **/
+        void add_wake_reason(const uint8_t p_reasons) {
+            m_wake_reasons.fetch_or(p_reasons);
+            request_run();
+        }
+
+        /**
+         * Leave the wake list before consuming the wake-ups: a wake-up racing with the
+         * consumption lists the agent again (sequentially consistent, never lost).
+         **/
+        void leave_wake_list() {
+            m_is_listed.store(false);
+        }
 
         // Public methods
     public:
@@ -96,7 +245,80 @@ namespace godot {
          * @param p_observed Observed properties
          * @return True if the agent is observable
          **/
-        //[[nodiscard]] bool perception_filter(const Dictionary& p_observed);
+        [[nodiscard]] bool perception_filter(const Dictionary& p_observed);
+
+        /**
+         * Declarative perception filter, e.g. "type == PREY and energy > 3 and distance < 10",
+         * evaluated natively instead of calling "_perception_filter".
+         * @param p_expression Filter expression (see PerceptionFilter), empty to remove the filter
+         * @param p_constants Names usable as constants in the expression (e.g. enum values)
+         * @return false if the expression is not valid (the previous filter is removed)
+         **/
+        bool set_perception_filter(const String& p_expression, const Dictionary& p_constants = Dictionary());
+
+        /**
+         * True if a native perception filter is set.
+         * @return True if a native perception filter is set
+         **/
+        [[nodiscard]] bool has_perception_filter() const {
+            return m_perception_filter.is_valid();
+        }
+
+        [[nodiscard]] const PerceptionFilter& get_perception_filter() const {
+            return m_perception_filter;
+        }
+
+        [[nodiscard]] const std::vector<String>& get_perception_filter_keys() const {
+            return m_perception_filter_keys;
+        }
+
+        /**
+         * Typed field ID of each observable of the filter (s_no_field: untyped observable).
+         * @param p_columns Typed observables of the environment
+         * @return field IDs
+         **/
+        [[nodiscard]] const std::vector<uint32_t>& get_perception_filter_fields(const ObservableColumns& p_columns);
+
+        // Hooks
+
+        /**
+         * Build the hook names (extension initialization).
+         **/
+        static void initialize_hook_names();
+
+        /**
+         * Release the hook names (extension uninitialization).
+         **/
+        static void release_hook_names();
+
+        /**
+         * Check once which hooks the script defines, the others are never called.
+         **/
+        void resolve_hooks();
+
+        /**
+         * True if the hook is defined.
+         * @param p_hook hook
+         * @return True if the hook is defined
+         **/
+        [[nodiscard]] bool has_hook(const Hook p_hook) const {
+            return m_hooks & (1u << p_hook);
+        }
+
+        /**
+         * Call a hook through its bound callable (no name lookup through Object::call),
+         * by name before resolve_hooks.
+         * @param p_hook hook
+         * @param p_args Arguments
+         * @return hook result
+         **/
+        template<typename... Args>
+        Variant call_hook(const Hook p_hook, const Args&... p_args) {
+            if (const Callable& l_call = m_hook_calls[p_hook]; l_call.is_valid()) {
+                return l_call.call(p_args...);
+            }
+            return call((*s_hook_names)[p_hook], p_args...);
+        }
 
         // Others
 
@@ -156,6 +378,16 @@ namespace godot {
             return m_id;
         }
 
+        AgentHandle get_handle() const {
+            return m_handle;
+        }
+        void set_handle(const AgentHandle p_handle) {
+            m_handle = p_handle;
+        }
+        int64_t get_agent_handle() const {
+            return static_cast<int64_t>(m_handle);
+        }
+
         String get_label() const {
             return m_label;
         }
@@ -168,6 +400,30 @@ namespace godot {
         void set_can_see(bool p_can_see) {
             m_can_see = p_can_see;
         }*/
+        Vector2 get_spatial_position() const {
+            return m_spatial_position;
+        }
+        void set_spatial_position(const Vector2& p_spatial_position);
+
+        /**
+         * True if the agent has a position in the spatial index.
+         * @return True if placed
+         **/
+        [[nodiscard]] bool is_placed() const {
+            return m_is_placed;
+        }
+
+        bool get_message_driven() const {
+            return m_is_message_driven;
+        }
+        void set_message_driven(const bool p_is_message_driven) {
+            m_is_message_driven = p_is_message_driven;
+            // Runs every turn again
+            if (!p_is_message_driven) {
+                request_run();
+            }
+        }
+
         Dictionary get_observables() const {
             return m_observables;
         }
@@ -175,6 +431,28 @@ namespace godot {
             m_observables = std::move(p_observables);
         }
 
+        /**
+         * Typed observable declared in the environment schema.
+         * @param p_name Field name
+         * @param p_value Value
+         * @return false if the field is not declared
+         **/
+        bool set_observable(const String& p_name, const Variant& p_value) const;
+        [[nodiscard]] Variant get_observable(const String& p_name) const;
+
+        /**
+         * Observables as published at the turn start.
+         * @return read-only observables
+         **/
+        [[nodiscard]] const Dictionary& get_published_observables() const {
+            return m_published_observables;
+        }
+
+        /**
+         * Publish the observables: the others see this state until the next turn.
+         **/
+        void publish_observables();
+
         /**
          * True if using observables.
          * @return True if using observables
@@ -196,26 +474,173 @@ namespace godot {
          * @return True if is dead
          **/
         [[nodiscard]] bool is_dead() const {
-            return m_is_dead;
+            return m_is_dead.load(std::memory_order_relaxed);
         }
 
         /**
          * Receive a new message.
          * @param p_message The new message
          **/
-        void post(const MessagePointer& p_message) {
-            m_messages.enqueue(p_message);
+        void post(Message&& p_message) {
+            m_messages.enqueue(std::move(p_message));
+            add_wake_reason(WAKE_MESSAGE);
+        }
+
+        /**
+         * Run a message-driven agent at the next turn and call its "_default_action".
+         **/
+        void wake() {
+            add_wake_reason(WAKE_EXPLICIT);
+        }
+
+        /**
+         * A timer of the agent fired (turn start, no agent running).
+         * @param p_id Timer ID
+         **/
+        void fire_timer(const int64_t p_id) {
+            m_fired_timers.push_back(p_id);
+            add_wake_reason(WAKE_TIMER);
+        }
+
+        /**
+         * Put the agent on the wake list of its environment if it is not there yet
+         * (any thread, nothing before registration).
+         **/
+        void request_run();
+
+        /**
+         * Mark the agent as listed, called by the environment when it lists the agent itself.
+         * @return false if it was already listed
+         **/
+        [[nodiscard]] bool mark_listed() {
+            return !m_is_listed.exchange(true);
+        }
+
+        /**
+         * True if the agent is on the wake list of its environment.
+         * @return true if listed
+         **/
+        [[nodiscard]] bool is_listed() const {
+            return m_is_listed.load();
+        }
+
+        /**
+         * EventDriven: an event of the agent is due, consume the wake-ups (the agent
+         * acts: "_default_action" is called if there is no message).
+         * @param p_time Simulated time
+         * @param p_instant Instant (several events of an agent at the same instant run it once)
+         * @return false if the agent already runs at this instant
+         **/
+        [[nodiscard]] bool begin_event(const double p_time, const uint64_t p_instant) {
+            if (m_event_instant == p_instant) {
+                return false;
+            }
+            m_event_instant = p_instant;
+            m_event_elapsed_time = m_last_event_time < 0.0 ? 0.0f : static_cast<float>(p_time - m_last_event_time);
+            m_last_event_time = p_time;
+            if (m_is_message_driven) {
+                leave_wake_list();
+            }
+            m_turn_wake_reasons = m_wake_reasons.exchange(0) | WAKE_EXPLICIT;
+            return true;
+        }
+
+        /**
+         * EventDriven: simulated time since the previous event of the agent.
+         * @return elapsed time
+         **/
+        [[nodiscard]] float get_event_elapsed_time() const {
+            return m_event_elapsed_time;
+        }
+
+        /**
+         * Add a measured run time to the moving average (cost balancing, called by the
+         * thread running the agent).
+         * @param p_nanoseconds Run time of the turn
+         **/
+        void record_run_cost(const uint64_t p_nanoseconds) {
+            const auto l_cost = static_cast<double>(p_nanoseconds);
+            m_run_cost = m_run_cost == 0.0 ? l_cost : m_run_cost + 0.25 * (l_cost - m_run_cost);
+        }
+
+        /**
+         * Moving average of the run time of the agent.
+         * @return nanoseconds, 0 if never measured
+         **/
+        [[nodiscard]] double get_run_cost() const {
+            return m_run_cost;
+        }
+        [[nodiscard]] double get_run_cost_usec() const {
+            return m_run_cost / 1000.0;
         }
 
+        /**
+         * Consume the wake-ups, called by the environment before running the agent.
+         * @return True if the agent must run this turn (always for an agent that is not message-driven)
+         **/
+        [[nodiscard]] bool take_wake_up() {
+            if (!m_is_message_driven) {
+                return true;
+            }
+            leave_wake_list();
+            m_turn_wake_reasons = m_wake_reasons.exchange(0);
+            return m_turn_wake_reasons != 0 || !m_is_setup;
+        }
+
+        /**
+         * Registration: rank of the agent in the environment, resets the ordering stamps.
+         * @param p_schedule_index Registration rank
+         **/
+        [[nodiscard]] uint32_t get_schedule_index() const {
+            return m_schedule_index;
+        }
+        void set_schedule_index(const uint32_t p_schedule_index) {
+            m_schedule_index = p_schedule_index;
+            m_order_count = 0;
+            m_order_turn = -1;
+        }
+
+        /**
+         * Synchronous delivery: move the messages received during the last turn to the
+         * front mailbox, ordered by sender position then sending order.
+         **/
+        void swap_mailboxes();
+
+        /**
+         * Set the random stream ID (unique in the environment).
+         * @param p_random_stream_id Stream ID
+         **/
+        void set_random_stream_id(const uint32_t p_random_stream_id) {
+            m_random_stream_id = p_random_stream_id;
+            m_random_turn = -1;
+        }
+
+        /**
+         * Random stream of the agent, restarted at each turn so draws do not
+         * depend on which worker runs the agent.
+         * @return random stream
+         **/
+        [[nodiscard]] RandomStream& get_random_stream();
+
+        /**
+         * Agent running its turn on the calling thread.
+         * @return the agent or nullptr
+         **/
+        [[nodiscard]] static GDAgent* get_running_agent();
+
+        /**
+         * Ordering stamp of the next message or intent of this agent: registration rank
+         * of the agent, then issue order in the current turn (independent of the threads).
+         * @return ordering stamp
+         **/
+        [[nodiscard]] uint64_t next_order() const;
+
         /**
          * Stops the execution of the agent and removes it from the environment.
          * Use the Stop method instead of Environment.
          * Remove when the decision to be stopped belongs to the agent itself.
          **/
-        void stop() {
-            m_is_dead = true;
-            call("emit_signal", "stopped");
-        }
+        void stop();
 
         /**
          * Send a new message by ID.
@@ -224,6 +649,13 @@ namespace godot {
          **/
         void send(const String& p_receiver_id, const String& p_message) const;
 
+        /**
+         * Send a new message by handle (no string lookup).
+         * @param p_receiver_handle The handle of the receiver
+         * @param p_message The message
+         **/
+        void send_handle(int64_t p_receiver_handle, const String& p_message) const;
+
         /**
          * Send a new message by label.
          * @param p_receiver_label The label of the receiver
@@ -247,6 +679,34 @@ namespace godot {
          **/
         void broadcast(const String& p_message) const;
 
+        /**
+         * Call "_timer(delta, timer_id)" in p_turns turns.
+         * @param p_turns Delay in turns (at least 1)
+         * @return timer ID
+         **/
+        int64_t set_timer(int p_turns) const;
+
+        /**
+         * Deliver a message in p_turns turns.
+         * @param p_receiver_id The id of the receiver
+         * @param p_message The message
+         * @param p_turns Delay in turns (at least 1)
+         * @return timer ID, 0 if the receiver is not registered
+         **/
+        int64_t send_delayed(const String& p_receiver_id, const String& p_message, int p_turns) const;
+
+        /**
+         * Cancel a timer or a delayed message.
+         * @param p_id Timer ID
+         **/
+        void cancel_timer(int64_t p_id) const;
+
+        /**
+         * EventDriven: act again in p_delay simulated time.
+         * @param p_delay Delay (0: at the current time, after the current instant)
+         **/
+        void schedule_action(double p_delay) const;
+
         /**
          * Return random number (long)
          * @return random value between 0 and 4294967295
@@ -341,11 +801,24 @@ namespace godot {
          **/
         virtual void action(float p_elapsed_time);
 
+        /**
+         * Compute action with the whole mailbox in one script call:
+         * "_action_batch(delta, senders: PackedStringArray, messages: PackedStringArray)".
+         * @param p_elapsed_time elapsed time between two calls
+         **/
+        virtual void action_batch(float p_elapsed_time);
+
         /**
          * Compute action if there is no message.
          * @param p_elapsed_time elapsed time between two calls
          **/
         virtual void default_action(float p_elapsed_time);
+
+        /**
+         * Call "_timer" for each timer fired since the last run.
+         * @param p_elapsed_time elapsed time between two calls
+         **/
+        virtual void timers(float p_elapsed_time);
     };
 }
 
@@ -1,8 +1,14 @@
 #include "GDEnvironment.h"
 
-#include <random>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
 
 #include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/classes/os.hpp>
+#include <godot_cpp/classes/project_settings.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
 
 #include "GDAgent.h"
 #include "Message.h"
@@ -27,10 +33,27 @@ void GDEnvironment::_bind_methods() {
 
     ClassDB::bind_method(D_METHOD("add"), &GDEnvironment::add);
     ClassDB::bind_method(D_METHOD("one_turn"), &GDEnvironment::one_turn);
+    ClassDB::bind_method(D_METHOD("run_until", "time", "emit_every"), &GDEnvironment::run_until, DEFVAL(0));
+    ClassDB::bind_method(D_METHOD("get_time"), &GDEnvironment::get_time);
+    ClassDB::bind_method(D_METHOD("get_next_event_time"), &GDEnvironment::get_next_event_time);
+    ClassDB::bind_method(D_METHOD("run_turns", "turns", "emit_every", "stop_if_empty", "stop_predicate", "elapsed_time"), &GDEnvironment::run_turns, DEFVAL(0), DEFVAL(false), DEFVAL(Callable()), DEFVAL(0.0));
+    ClassDB::bind_method(D_METHOD("get_barrier_wait_histogram"), &GDEnvironment::get_barrier_wait_histogram);
+    ClassDB::bind_method(D_METHOD("reset_barrier_wait_histogram"), &GDEnvironment::reset_barrier_wait_histogram);
+    ClassDB::bind_method(D_METHOD("get_auto_mode_report"), &GDEnvironment::get_auto_mode_report);
+    ClassDB::bind_method(D_METHOD("get_load_report"), &GDEnvironment::get_load_report);
     ClassDB::bind_method(D_METHOD("stop"), &GDEnvironment::stop);
     ClassDB::bind_method(D_METHOD("get_turn"), &GDEnvironment::get_turn);
     ClassDB::bind_method(D_METHOD("agents_count"), &GDEnvironment::agents_count);
     ClassDB::bind_method(D_METHOD("get_agent"), &GDEnvironment::get_agent);
+    ClassDB::bind_method(D_METHOD("get_agent_by_handle"), &GDEnvironment::get_agent_by_handle);
+    ClassDB::bind_method(D_METHOD("get_agent_handle"), &GDEnvironment::get_agent_handle);
+    ClassDB::bind_method(D_METHOD("get_agent_ids"), &GDEnvironment::get_agent_ids);
+    ClassDB::bind_method(D_METHOD("add_observable"), &GDEnvironment::add_observable);
+    ClassDB::bind_method(D_METHOD("get_observable_column"), &GDEnvironment::get_observable_column);
+    ClassDB::bind_method(D_METHOD("query_radius"), &GDEnvironment::query_radius);
+    ClassDB::bind_method(D_METHOD("query_rect"), &GDEnvironment::query_rect);
+    ClassDB::bind_method(D_METHOD("record_intent", "kind", "target", "data"), &GDEnvironment::record_intent, DEFVAL(Variant()), DEFVAL(Variant()));
+    ClassDB::bind_method(D_METHOD("set_intent_handler", "kind", "apply", "resolver"), &GDEnvironment::set_intent_handler, DEFVAL(Callable()));
 
     ClassDB::bind_method(D_METHOD("randi"), &GDEnvironment::randi);
     ClassDB::bind_method(D_METHOD("randi_range"), &GDEnvironment::randi_range);
@@ -45,13 +68,15 @@ void GDEnvironment::_bind_methods() {
     BIND_ENUM_CONSTANT(Parallel);
     BIND_ENUM_CONSTANT(Sequential);
     BIND_ENUM_CONSTANT(SequentialRandom);
+    BIND_ENUM_CONSTANT(EventDriven);
+    BIND_ENUM_CONSTANT(Auto);
 
     // Properties
     ClassDB::bind_method(D_METHOD("set_environment_mas_mode"), &GDEnvironment::set_environment_mas_mode);
     ClassDB::bind_method(D_METHOD("get_environment_mas_mode"), &GDEnvironment::get_environment_mas_mode);
     ClassDB::add_property(
             "GDEnvironment",
-            PropertyInfo(Variant::STRING, "environment_mas_mode", PROPERTY_HINT_ENUM, "Parallel,Sequential,Sequential Random"),
+            PropertyInfo(Variant::STRING, "environment_mas_mode", PROPERTY_HINT_ENUM, "Parallel,Sequential,Sequential Random,Event Driven,Auto"),
             "set_environment_mas_mode",
             "get_environment_mas_mode"
     );
@@ -73,6 +98,96 @@ void GDEnvironment::_bind_methods() {
             "set_using_custom_see",
             "get_using_custom_see"
     );
+
+    ClassDB::bind_method(D_METHOD("set_using_synchronous_delivery"), &GDEnvironment::set_using_synchronous_delivery);
+    ClassDB::bind_method(D_METHOD("get_using_synchronous_delivery"), &GDEnvironment::get_using_synchronous_delivery);
+    ClassDB::add_property(
+            "GDEnvironment",
+            PropertyInfo(Variant::BOOL, "is_using_synchronous_delivery", PROPERTY_HINT_NONE, "If true, messages sent during a turn are received at the next turn"),
+            "set_using_synchronous_delivery",
+            "get_using_synchronous_delivery"
+    );
+
+    ClassDB::bind_method(D_METHOD("set_using_parallel_events"), &GDEnvironment::set_using_parallel_events);
+    ClassDB::bind_method(D_METHOD("get_using_parallel_events"), &GDEnvironment::get_using_parallel_events);
+    ClassDB::add_property(
+            "GDEnvironment",
+            PropertyInfo(Variant::BOOL, "is_using_parallel_events", PROPERTY_HINT_NONE, "Event Driven: if true, agents of events with the same time run in parallel"),
+            "set_using_parallel_events",
+            "get_using_parallel_events"
+    );
+
+    ClassDB::bind_method(D_METHOD("set_max_workers"), &GDEnvironment::set_max_workers);
+    ClassDB::bind_method(D_METHOD("get_max_workers"), &GDEnvironment::get_max_workers);
+    ClassDB::add_property(
+            "GDEnvironment",
+            PropertyInfo(Variant::INT, "max_workers", PROPERTY_HINT_NONE, "Maximum number of threads running the agents (0 means all)"),
+            "set_max_workers",
+            "get_max_workers"
+    );
+
+    ClassDB::bind_method(D_METHOD("set_using_engine_workers"), &GDEnvironment::set_using_engine_workers);
+    ClassDB::bind_method(D_METHOD("get_using_engine_workers"), &GDEnvironment::get_using_engine_workers);
+    ClassDB::add_property(
+            "GDEnvironment",
+            PropertyInfo(Variant::BOOL, "is_using_engine_workers", PROPERTY_HINT_NONE, "If true, parallel turns run on the engine WorkerThreadPool"),
+            "set_using_engine_workers",
+            "get_using_engine_workers"
+    );
+
+    ClassDB::bind_method(D_METHOD("set_using_cost_balancing"), &GDEnvironment::set_using_cost_balancing);
+    ClassDB::bind_method(D_METHOD("get_using_cost_balancing"), &GDEnvironment::get_using_cost_balancing);
+    ClassDB::add_property(
+            "GDEnvironment",
+            PropertyInfo(Variant::BOOL, "is_using_cost_balancing", PROPERTY_HINT_NONE, "If true, parallel turns are split by the measured run time of the agents"),
+            "set_using_cost_balancing",
+            "get_using_cost_balancing"
+    );
+
+    ClassDB::bind_method(D_METHOD("set_worker_count"), &GDEnvironment::set_worker_count);
+    ClassDB::bind_method(D_METHOD("get_worker_count"), &GDEnvironment::get_worker_count);
+    ClassDB::add_property(
+            "GDEnvironment",
+            PropertyInfo(Variant::INT, "worker_count", PROPERTY_HINT_NONE, "Threads of the shared scheduler, calling thread included (0 means one per core)"),
+            "set_worker_count",
+            "get_worker_count"
+    );
+
+    ClassDB::bind_method(D_METHOD("set_worker_affinity_mask"), &GDEnvironment::set_worker_affinity_mask);
+    ClassDB::bind_method(D_METHOD("get_worker_affinity_mask"), &GDEnvironment::get_worker_affinity_mask);
+    ClassDB::add_property(
+            "GDEnvironment",
+            PropertyInfo(Variant::INT, "worker_affinity_mask", PROPERTY_HINT_NONE, "Cores the workers are pinned to, one bit per core (0 means no pinning)"),
+            "set_worker_affinity_mask",
+            "get_worker_affinity_mask"
+    );
+
+    ClassDB::bind_method(D_METHOD("set_worker_spin_usec"), &GDEnvironment::set_worker_spin_usec);
+    ClassDB::bind_method(D_METHOD("get_worker_spin_usec"), &GDEnvironment::get_worker_spin_usec);
+    ClassDB::add_property(
+            "GDEnvironment",
+            PropertyInfo(Variant::INT, "worker_spin_usec", PROPERTY_HINT_NONE, "Time an idle worker polls for the next turn, and the environment for the end of the turn, before sleeping (microseconds)"),
+            "set_worker_spin_usec",
+            "get_worker_spin_usec"
+    );
+
+    ClassDB::bind_method(D_METHOD("set_worker_name_prefix"), &GDEnvironment::set_worker_name_prefix);
+    ClassDB::bind_method(D_METHOD("get_worker_name_prefix"), &GDEnvironment::get_worker_name_prefix);
+    ClassDB::add_property(
+            "GDEnvironment",
+            PropertyInfo(Variant::STRING, "worker_name_prefix", PROPERTY_HINT_NONE, "Worker thread name prefix, as shown by profilers"),
+            "set_worker_name_prefix",
+            "get_worker_name_prefix"
+    );
+
+    ClassDB::bind_method(D_METHOD("set_cell_size"), &GDEnvironment::set_cell_size);
+    ClassDB::bind_method(D_METHOD("get_cell_size"), &GDEnvironment::get_cell_size);
+    ClassDB::add_property(
+            "GDEnvironment",
+            PropertyInfo(Variant::FLOAT, "cell_size", PROPERTY_HINT_NONE, "Cell size of the spatial index, close to the usual perception radius"),
+            "set_cell_size",
+            "get_cell_size"
+    );
 }
 
 void GDEnvironment::set_environment_mas_mode(const String& p_environment_mas_mode) {
@@ -80,6 +195,10 @@ void GDEnvironment::set_environment_mas_mode(const String& p_environment_mas_mod
         m_environment_mas_mode = GDEnvironment::EnvironmentMode::Sequential;
     } else if (p_environment_mas_mode == "Sequential Random") {
         m_environment_mas_mode = GDEnvironment::EnvironmentMode::SequentialRandom;
+    } else if (p_environment_mas_mode == "Event Driven") {
+        m_environment_mas_mode = GDEnvironment::EnvironmentMode::EventDriven;
+    } else if (p_environment_mas_mode == "Auto") {
+        m_environment_mas_mode = GDEnvironment::EnvironmentMode::Auto;
     } else {
         m_environment_mas_mode = GDEnvironment::EnvironmentMode::Parallel;
     }
@@ -89,49 +208,99 @@ String GDEnvironment::get_environment_mas_mode() const {
         return "Sequential";
     } else if (m_environment_mas_mode == GDEnvironment::EnvironmentMode::SequentialRandom) {
         return "Sequential Random";
+    } else if (m_environment_mas_mode == GDEnvironment::EnvironmentMode::EventDriven) {
+        return "Event Driven";
+    } else if (m_environment_mas_mode == GDEnvironment::EnvironmentMode::Auto) {
+        return "Auto";
     }
     return "Parallel";
 }
 
+void GDEnvironment::set_worker_count(const int p_worker_count) {
+    configure_scheduler([p_worker_count](TaskScheduler::Settings& p_settings) {
+        p_settings.m_worker_count = static_cast<size_t>(std::max(p_worker_count, 0));
+    });
+}
+
+void GDEnvironment::set_worker_affinity_mask(const int64_t p_worker_affinity_mask) {
+    configure_scheduler([p_worker_affinity_mask](TaskScheduler::Settings& p_settings) {
+        p_settings.m_affinity_mask = static_cast<uint64_t>(p_worker_affinity_mask);
+    });
+}
+
+void GDEnvironment::set_worker_spin_usec(const int p_worker_spin_usec) {
+    configure_scheduler([p_worker_spin_usec](TaskScheduler::Settings& p_settings) {
+        p_settings.m_spin_microseconds = static_cast<uint32_t>(std::max(p_worker_spin_usec, 0));
+    });
+}
+
+void GDEnvironment::set_worker_name_prefix(const String& p_worker_name_prefix) {
+    const std::string l_prefix = p_worker_name_prefix.utf8().get_data();
+    configure_scheduler([&l_prefix](TaskScheduler::Settings& p_settings) {
+        p_settings.m_thread_name_prefix = l_prefix;
+    });
+}
+
 //###############################################################
 //	Internals
 //###############################################################
 
-void GDEnvironment::send(const String& p_sender_id, const String& p_receiver_id, const String& p_message) const {
+void GDEnvironment::send(const String& p_sender_id, const String& p_receiver_id, const String& p_message, const uint64_t p_order) const {
     const auto& l_agent = get(p_receiver_id.utf8().get_data());
     if (l_agent) {
         if (l_agent.value()->is_dead()) {
             return;
         }
-        l_agent.value()->post(std::make_shared<Message>(p_sender_id, p_receiver_id, p_message));
+        l_agent.value()->post(Message(std::make_shared<const MessagePayload>(p_sender_id, p_message), l_agent.value()->get_handle(), p_order));
     }
 }
 
-void GDEnvironment::send_by_label(const String& p_sender_id, const String& p_receiver_label, const String& p_message, const bool p_is_fragment, const bool p_first_only) const {
+void GDEnvironment::send(const String& p_sender_id, const AgentHandle p_receiver, const String& p_message, const uint64_t p_order) const {
+    GDAgent* l_agent = get(p_receiver);
+    if (l_agent && !l_agent->is_dead()) {
+        l_agent->post(Message(std::make_shared<const MessagePayload>(p_sender_id, p_message), p_receiver, p_order));
+    }
+}
+
+void GDEnvironment::send_by_label(const String& p_sender_id, const String& p_receiver_label, const String& p_message, const bool p_is_fragment, const bool p_first_only, const uint64_t p_order) const {
     const std::string& l_receiver_label = p_receiver_label.utf8().get_data();
-    for (auto l_filtered_elements = m_agents_by_label | std::views::filter([p_is_fragment, l_receiver_label](auto& p_value) {
-        if (p_is_fragment) {
-            return p_value.first.find(l_receiver_label) != std::string::npos;
-        }
-        return p_value.first == l_receiver_label;
-    });
-    const auto& [l_name, l_id] : l_filtered_elements) {
-        const auto& l_agent = get(l_id);
-        if (!l_agent || l_agent.value()->is_dead()) {
-            continue;
+    const MessagePayloadPointer l_payload = std::make_shared<const MessagePayload>(p_sender_id, p_message);
+
+    // Post to all agents of a label, false if done (first only)
+    const auto l_post = [&](const uint32_t p_label) {
+        for (const AgentHandle l_handle: m_agents_by_label[p_label]) {
+            GDAgent* l_agent = get(l_handle);
+            if (l_agent->is_dead()) {
+                continue;
+            }
+
+            l_agent->post(Message(l_payload, l_handle, p_order));
+            if (p_first_only) {
+                return false;
+            }
         }
+        return true;
+    };
 
-        l_agent.value()->post(std::make_shared<Message>(p_sender_id, l_id.c_str(), p_message));
-        if (p_first_only) {
+    if (!p_is_fragment) {
+        if (const auto& l_label = m_label_ids.find(l_receiver_label); l_label != m_label_ids.end()) {
+            l_post(l_label->second);
+        }
+        return;
+    }
+    for (uint32_t l_label = 0; l_label < m_labels.size(); ++l_label) {
+        if (m_labels[l_label].find(l_receiver_label) != std::string::npos && !l_post(l_label)) {
             break;
         }
     }
 }
 
-void GDEnvironment::broadcast(const String& p_sender_id, const String& p_message) const {
-    for (auto& [l_id, l_agent]: m_agents) {
-        if (l_id != p_sender_id.utf8().get_data() && !l_agent->is_dead()) {
-            l_agent->post(std::make_shared<Message>(p_sender_id, l_id.c_str(), p_message));
+void GDEnvironment::broadcast(const String& p_sender_id, const String& p_message, const uint64_t p_order) const {
+    const MessagePayloadPointer l_payload = std::make_shared<const MessagePayload>(p_sender_id, p_message);
+    for (const AgentHandle l_handle: m_agent_order) {
+        GDAgent* l_agent = get(l_handle);
+        if (l_agent && !l_agent->is_dead() && l_agent->get_id() != p_sender_id) {
+            l_agent->post(Message(l_payload, l_handle, p_order));
         }
     }
 }
@@ -143,7 +312,7 @@ String GDEnvironment::add(const Variant& p_agent) {
         l_agent->set_environment(this);
         l_agent->set_process(false);
         l_agent->set_physics_process(false);
-        m_new_agents.enqueue(l_agent);
+        m_new_agents.enqueue({next_order(), l_agent});
         return l_agent->get_id();
     }
     return "";
@@ -151,9 +320,10 @@ String GDEnvironment::add(const Variant& p_agent) {
 
 
 void GDEnvironment::remove(const String& p_id) {
-    const std::string l_id = p_id.utf8().get_data();
-    if (m_agents.contains(l_id)) {
-        m_agents.erase(l_id);
+    // Unregistered at the beginning of the next turn
+    const auto& l_agent = get(p_id.utf8().get_data());
+    if (l_agent && !l_agent.value()->is_dead()) {
+        l_agent.value()->stop();
     }
 }
 
@@ -167,12 +337,91 @@ void GDEnvironment::add_nodes_on_tree() {
             l_agent->set_environment(this);
             l_agent->set_process(false);
             l_agent->set_physics_process(false);
-            m_new_agents.enqueue(l_agent);
+            m_new_agents.enqueue({next_order(), l_agent});
+        }
+    }
+}
+
+void GDEnvironment::register_agent(GDAgent* p_agent) {
+    const auto [l_label, l_is_new_label] = m_label_ids.try_emplace(p_agent->get_label().utf8().get_data(), static_cast<uint32_t>(m_labels.size()));
+    if (l_is_new_label) {
+        m_labels.push_back(l_label->first);
+        m_agents_by_label.emplace_back();
+    }
+    std::vector<AgentHandle>& l_label_agents = m_agents_by_label[l_label->second];
+
+    const AgentHandle l_handle = m_agents.insert({p_agent, l_label->second, static_cast<uint32_t>(l_label_agents.size())});
+    l_label_agents.push_back(l_handle);
+    m_agent_order.push_back(l_handle);
+    m_agents_by_id.emplace(p_agent->get_id().utf8().get_data(), l_handle);
+    p_agent->set_handle(l_handle);
+    p_agent->set_random_stream_id(++m_random_streams);
+    p_agent->set_schedule_index(m_schedule_sequence++);
+    p_agent->resolve_hooks();
+    m_observable_columns.reset_row(SlotMap<AgentEntry>::index_of(l_handle));
+    if (m_environment_mas_mode == EnvironmentMode::EventDriven) {
+        // Setup and first action at the current time
+        m_events.push({m_time, m_event_sequence++, l_handle});
+    }
+    if (p_agent->is_placed()) {
+        const Vector2 l_position = p_agent->get_spatial_position();
+        m_spatial_index.move(l_handle, l_position.x, l_position.y);
+    }
+
+    // Setup turn (registration order is schedule order), stopped before registration: swept next turn
+    if (p_agent->mark_listed()) {
+        m_wake_list.push_back(p_agent);
+    }
+    if (p_agent->is_dead()) {
+        agent_stopped();
+    }
+}
+
+void GDEnvironment::unregister_agent(const AgentHandle p_handle) {
+    const AgentEntry l_entry = *m_agents.get(p_handle);
+
+    // Swap and pop in the label index
+    std::vector<AgentHandle>& l_label_agents = m_agents_by_label[l_entry.m_label];
+    const AgentHandle l_moved = l_label_agents.back();
+    l_label_agents[l_entry.m_label_position] = l_moved;
+    m_agents.get(l_moved)->m_label_position = l_entry.m_label_position;
+    l_label_agents.pop_back();
+
+    m_agents_by_id.erase(l_entry.m_agent->get_id().utf8().get_data());
+    m_spatial_index.erase(p_handle);
+    m_agents.erase(p_handle);
+}
+
+void GDEnvironment::one_turn(const float p_elapsed_time) {
+    run_turn(p_elapsed_time, true);
+}
+
+int GDEnvironment::run_turns(const int p_turns, const int p_emit_every, const bool p_stop_if_empty, const Callable& p_stop_predicate, const float p_elapsed_time) {
+    int l_turns = 0;
+    while (l_turns < p_turns) {
+        const int l_turn = m_turn;
+        const bool l_is_last = l_turns + 1 == p_turns;
+        run_turn(p_elapsed_time, p_emit_every > 0 && (l_is_last || (l_turns + 1) % p_emit_every == 0));
+        ++l_turns;
+
+        const bool l_is_stopping = (p_stop_if_empty && !has_alive_agents()) ||
+                (p_stop_predicate.is_valid() && p_stop_predicate.call(l_turn).booleanize());
+        if (l_is_stopping) {
+            // The last turn is always reported
+            if (p_emit_every > 0 && !l_is_last && l_turns % p_emit_every != 0) {
+                turn_finished(l_turn);
+            }
+            break;
         }
     }
+    return l_turns;
+}
+
+bool GDEnvironment::has_alive_agents() const {
+    return m_agents.size() > m_stopped_agent_count.load(std::memory_order_relaxed) || has_new_agents();
 }
 
-void GDEnvironment::one_turn(float p_elapsed_time) {
+void GDEnvironment::run_turn(const float p_elapsed_time, const bool p_is_emitting) {
 
     /**
      * First turn add all node already on the tree
@@ -182,42 +431,68 @@ void GDEnvironment::one_turn(float p_elapsed_time) {
         add_nodes_on_tree();
     }
 
+    // Intents issued between turns
+    commit_intents();
+
     /**
      * Process buffers
      */
 
-    // Remove dead agents
-    std::vector<GDAgent*> l_to_delete_agents;
-    l_to_delete_agents.reserve(m_agents.size());
-    for (auto& [l_id, l_agent]: m_agents) {
-        if (l_agent->is_dead()) {
-            l_to_delete_agents.push_back(l_agent);
-            const auto [l_start, l_end] = m_agents_by_label.equal_range(l_agent->get_label().utf8().get_data());
-            for (auto l_agent_it = l_start; l_agent_it != l_end; ++l_agent_it) {
-                if (l_agent_it->second == l_id) {
-                    m_agents_by_label.erase(l_agent_it);
-                    break;
-                }
-            }
+    // Agents that consumed their wake-ups and were not woken since leave the wake list
+    m_wake_list.begin_turn();
+
+    // Remove dead agents (all on the wake list)
+    if (m_stopped_agent_count.load(std::memory_order_relaxed) != 0) {
+        const size_t l_removed = m_wake_list.sweep([this](GDAgent* p_agent) {
+            agent_removed(p_agent);
+            unregister_agent(p_agent->get_handle());
+            memdelete(p_agent);
+        });
+        m_stopped_agent_count.fetch_sub(static_cast<uint32_t>(l_removed), std::memory_order_relaxed);
+        m_stale_order_count += l_removed;
+
+        // Scheduling order: one stable compaction once half of it is stale
+        if (m_stale_order_count * 2 > m_agent_order.size()) {
+            std::erase_if(m_agent_order, [this](const AgentHandle p_handle) {
+                return !m_agents.contains(p_handle);
+            });
+            m_stale_order_count = 0;
         }
     }
 
-    for (const auto& l_agent: l_to_delete_agents) {
-        m_agents.erase(l_agent->get_id().utf8().get_data());
-        memdelete(l_agent);
-    }
-
-    // Add new agents
-    if (GDAgent* l_agent; m_new_agents.dequeue(l_agent)) {
+    // Add new agents, in stamp order (arrival order depends on the workers)
+    if (NewAgent l_new_agent; m_new_agents.dequeue(l_new_agent)) {
         do {
-            if (m_environment_mas_mode == EnvironmentMode::Parallel) {
-                call_deferred("add_child",l_agent);
+            m_registered_agents.push_back(l_new_agent);
+        } while (m_new_agents.dequeue(l_new_agent));
+        std::sort(m_registered_agents.begin(), m_registered_agents.end(), [](const NewAgent& p_left, const NewAgent& p_right) {
+            return p_left.m_order < p_right.m_order;
+        });
+        for (const NewAgent& l_registered: m_registered_agents) {
+            if (is_parallel()) {
+                call_deferred("add_child", l_registered.m_agent);
             } else {
-                call("add_child",l_agent);
+                call("add_child", l_registered.m_agent);
             }
-            m_agents.insert(std::make_pair(l_agent->get_id().utf8().get_data(), l_agent));
-            m_agents_by_label.insert(std::make_pair(l_agent->get_label().utf8().get_data(), l_agent->get_id().utf8().get_data()));
-        } while (m_new_agents.dequeue(l_agent));
+            register_agent(l_registered.m_agent);
+        }
+        m_registered_agents.clear();
+        m_wake_list.reserve(m_agents.size());
+    }
+
+    // Timers due this turn, delayed messages are delivered with the others
+    fire_timers();
+    m_wake_list.drain();
+
+    // Publish observables, deliver messages of the previous turn (agents on the wake
+    // list only: a sleeping agent has nothing to hand out and nothing received)
+    m_observable_columns.publish();
+    m_order_count = 0;
+    for (GDAgent* l_agent: m_wake_list) {
+        l_agent->publish_observables();
+        if (m_is_using_synchronous_delivery) {
+            l_agent->swap_mailboxes();
+        }
     }
 
     /**
@@ -226,43 +501,337 @@ void GDEnvironment::one_turn(float p_elapsed_time) {
 
     // Sequential
     if (m_environment_mas_mode == EnvironmentMode::Sequential) {
-        for (auto& [l_agent_id, l_agent]: m_agents) {
-            l_agent->run_turn(p_elapsed_time);
+        m_wake_list.run_in_order([p_elapsed_time](GDAgent* p_agent) {
+            p_agent->run_turn(p_elapsed_time);
+        });
+
+    // Parallel, Auto
+    } else if (m_environment_mas_mode == EnvironmentMode::Parallel || m_environment_mas_mode == EnvironmentMode::Auto) {
+        m_wake_list.schedule(m_scheduled_agents);
+        run_scheduled_agents_in_parallel(p_elapsed_time);
+
+    // Event driven: the agents of the next instant, setup and action in one run
+    } else if (m_environment_mas_mode == EnvironmentMode::EventDriven) {
+        collect_instant();
+        if (m_is_using_parallel_events) {
+            run_scheduled_agents_in_parallel(p_elapsed_time);
+        } else {
+            for (GDAgent* l_agent: m_scheduled_agents) {
+                l_agent->run_turn(l_agent->get_event_elapsed_time(), false);
+            }
         }
 
-    // Random
+    // Random (agents woken during the turn run at the next one)
     } else {
-        const auto m_parallel = m_environment_mas_mode == EnvironmentMode::Parallel;
-        std::vector<std::future<void>> l_asyncs;
-        const std::vector<std::string> l_agents = get_ids();
-        const auto l_count = l_agents.size();
-        const std::vector<int> l_agent_order = random_permutation(l_count);
-        size_t l_index = 0;
-
-        while (l_index < l_count) {
-            const std::string& l_agent_id = l_agents.at(l_agent_order.at(l_index++));
-            const auto& l_agent = get(l_agent_id);
-            if (l_agent) {
-                if (m_parallel) {
-                    l_asyncs.push_back(m_pool.addWorkFunc([l_agent, p_elapsed_time] {
-                        l_agent.value()->run_turn(p_elapsed_time);
-                    }));
-                } else {
-                    l_agent.value()->run_turn(p_elapsed_time);
-                }
-
+        for (const int l_index: random_permutation(m_wake_list.size())) {
+            if (GDAgent* l_agent = m_wake_list[l_index]; !l_agent->is_dead() && l_agent->take_wake_up()) {
+                l_agent->run_turn(p_elapsed_time);
             }
         }
-        for (std::future<void>& l_async: l_asyncs) {
-            l_async.wait();
-        }
     }
 
     /**
      * End of the turn
      */
 
-    turn_finished(m_turn++);
+    commit_intents();
+
+    if (p_is_emitting) {
+        turn_finished(m_turn);
+    }
+    ++m_turn;
+}
+
+void GDEnvironment::run_scheduled_agents_in_parallel(const float p_elapsed_time) {
+    const size_t l_count = m_scheduled_agents.size();
+    const bool l_is_using_engine = m_is_using_engine_workers && WorkerThreadPool::get_singleton();
+    if (!l_is_using_engine && !m_scheduler) {
+        m_scheduler = TaskScheduler::get_shared(m_worker_settings);
+    }
+    const size_t l_available = l_is_using_engine ? get_engine_worker_count() : m_scheduler->get_worker_count();
+    const size_t l_workers = m_max_workers > 0 ? std::min(static_cast<size_t>(m_max_workers), l_available) : l_available;
+
+    // A few chunks per worker, the scheduler splits them further when needed
+    AdaptiveDispatch::Decision l_decision = {true, std::max<size_t>(1, l_count / (l_workers * 8))};
+    const bool l_is_auto = m_environment_mas_mode == EnvironmentMode::Auto;
+    if (l_is_auto) {
+        l_decision = m_dispatch.decide(l_count, l_workers);
+    }
+
+    // Cost balancing: partitions of equal predicted cost, a few per worker so stealing still helps
+    const bool l_is_balancing = m_is_using_cost_balancing && l_decision.m_is_parallel;
+    if (l_is_balancing) {
+        build_partitions(l_workers * 4);
+    } else {
+        m_partition_bounds.clear();
+    }
+
+    m_is_running_parallel_turn = true;
+    const auto l_start = std::chrono::steady_clock::now();
+    if (!l_decision.m_is_parallel) {
+        m_worker_loads.assign(1, WorkerLoad());
+        run_scheduled_range(0, l_count, p_elapsed_time, 0);
+    } else if (l_is_using_engine) {
+        // The engine pool hands the chunks out on demand, one load slot per chunk
+        m_parallel_elapsed_time = p_elapsed_time;
+        m_parallel_chunk_count = static_cast<uint32_t>(l_is_balancing ? m_partition_bounds.size() - 1 : (l_count + l_decision.m_grain - 1) / l_decision.m_grain);
+        m_worker_loads.assign(std::max<size_t>(m_parallel_chunk_count, 1), WorkerLoad());
+        if (m_parallel_chunk_count > 0) {
+            if (m_run_chunk.is_null()) {
+                m_run_chunk = callable_mp(this, &GDEnvironment::run_scheduled_chunk);
+            }
+            const int64_t l_group = WorkerThreadPool::get_singleton()->add_group_task(
+                    m_run_chunk,
+                    static_cast<int32_t>(m_parallel_chunk_count),
+                    m_max_workers > 0 ? m_max_workers : -1,
+                    true,
+                    "GDEnvironment agents"
+            );
+
+            // The environment thread does not take part, it waits for the whole group
+            const auto l_wait_start = std::chrono::steady_clock::now();
+            WorkerThreadPool::get_singleton()->wait_for_group_task_completion(l_group);
+            m_barrier_waits.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - l_wait_start).count()));
+        }
+    } else {
+        // One load slot per worker of the job, sized under the job lock: the worker
+        // count may have changed since l_available was read, and a job may use fewer
+        // workers than l_workers (not enough chunks)
+        const auto l_prepare = [this](const size_t p_workers) {
+            m_worker_loads.assign(p_workers, WorkerLoad());
+        };
+        uint64_t l_wait;
+        if (l_is_balancing) {
+            l_wait = m_scheduler->parallel_for(m_partition_bounds.size() - 1, 1, [this, p_elapsed_time](const size_t p_begin, const size_t p_end) {
+                for (size_t l_partition = p_begin; l_partition < p_end; ++l_partition) {
+                    run_scheduled_range(m_partition_bounds[l_partition], m_partition_bounds[l_partition + 1], p_elapsed_time, TaskScheduler::get_current_worker());
+                }
+            }, l_workers, l_prepare);
+        } else {
+            l_wait = m_scheduler->parallel_for(l_count, l_decision.m_grain, [this, p_elapsed_time](const size_t p_begin, const size_t p_end) {
+                run_scheduled_range(p_begin, p_end, p_elapsed_time, TaskScheduler::get_current_worker());
+            }, l_workers, l_prepare);
+        }
+        m_barrier_waits.record(l_wait);
+    }
+    m_is_running_parallel_turn = false;
+
+    // Load of the turn: busiest worker against the average
+    uint64_t l_work = 0;
+    uint64_t l_max_work = 0;
+    for (const WorkerLoad& l_load: m_worker_loads) {
+        l_work += l_load.m_work;
+        l_max_work = std::max(l_max_work, l_load.m_work);
+    }
+    if (l_decision.m_is_parallel) {
+        // Engine slots are chunks, not threads: no imbalance
+        m_load_mean = static_cast<double>(l_work) / static_cast<double>(m_worker_loads.size());
+        m_load_max = static_cast<double>(l_max_work);
+        m_is_load_measured = !l_is_using_engine;
+        m_load_imbalance = m_load_mean > 0.0 ? m_load_max / m_load_mean : 1.0;
+        m_load_partition_count = l_is_balancing ? m_partition_bounds.size() - 1 : 0;
+    }
+    if (l_is_auto) {
+        const auto l_wall = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - l_start).count();
+        m_dispatch.record(l_count, l_workers, l_decision.m_is_parallel, static_cast<uint64_t>(l_wall), l_work);
+    }
+
+    // Moves of the turn (stamp order, so the last move of each agent wins)
+    m_pending_moves.drain(m_committed_moves);
+    for (const auto& l_move: m_committed_moves) {
+        if (m_agents.contains(l_move.m_command.m_handle)) {
+            m_spatial_index.move(l_move.m_command.m_handle, l_move.m_command.m_position.x, l_move.m_command.m_position.y);
+        }
+    }
+    m_committed_moves.clear();
+}
+
+size_t GDEnvironment::get_engine_worker_count() {
+    if (m_engine_worker_count == 0) {
+        const int64_t l_max_threads = ProjectSettings::get_singleton()->get_setting("threading/worker_pool/max_threads", -1);
+        m_engine_worker_count = l_max_threads > 0 ? static_cast<size_t>(l_max_threads) : static_cast<size_t>(std::max(OS::get_singleton()->get_processor_count(), 1));
+    }
+    return m_engine_worker_count;
+}
+
+void GDEnvironment::run_scheduled_range(const size_t p_begin, const size_t p_end, const float p_elapsed_time, const size_t p_slot) {
+    const bool l_is_event_driven = m_environment_mas_mode == EnvironmentMode::EventDriven;
+    const auto l_start = std::chrono::steady_clock::now();
+    auto l_agent_start = l_start;
+    for (size_t l_index = p_begin; l_index < p_end; ++l_index) {
+        GDAgent* l_agent = m_scheduled_agents[l_index];
+        if (l_is_event_driven) {
+            l_agent->run_turn(l_agent->get_event_elapsed_time(), false);
+        } else {
+            l_agent->run_turn(p_elapsed_time);
+        }
+        if (m_is_using_cost_balancing) {
+            const auto l_agent_end = std::chrono::steady_clock::now();
+            l_agent->record_run_cost(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(l_agent_end - l_agent_start).count()));
+            l_agent_start = l_agent_end;
+        }
+    }
+
+    // Work of the calling thread (load report, Auto cost model)
+    const auto l_work = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - l_start).count();
+    m_worker_loads[p_slot].m_work += static_cast<uint64_t>(l_work);
+}
+
+void GDEnvironment::run_scheduled_chunk(const uint32_t p_chunk) {
+    if (!m_partition_bounds.empty()) {
+        run_scheduled_range(m_partition_bounds[p_chunk], m_partition_bounds[p_chunk + 1], m_parallel_elapsed_time, p_chunk);
+        return;
+    }
+    const size_t l_count = m_scheduled_agents.size();
+    const size_t l_begin = l_count * p_chunk / m_parallel_chunk_count;
+    const size_t l_end = l_count * (p_chunk + 1) / m_parallel_chunk_count;
+    run_scheduled_range(l_begin, l_end, m_parallel_elapsed_time, p_chunk);
+}
+
+void GDEnvironment::build_partitions(const size_t p_partition_count) {
+    const size_t l_count = m_scheduled_agents.size();
+    const size_t l_partition_count = std::clamp<size_t>(p_partition_count, 1, std::max<size_t>(l_count, 1));
+
+    // Agents never measured (new, or asleep so far) count as the average agent
+    double l_known_cost = 0.0;
+    size_t l_known_count = 0;
+    for (const GDAgent* l_agent: m_scheduled_agents) {
+        if (l_agent->get_run_cost() > 0.0) {
+            l_known_cost += l_agent->get_run_cost();
+            ++l_known_count;
+        }
+    }
+    const double l_default_cost = l_known_count == 0 ? 1.0 : l_known_cost / static_cast<double>(l_known_count);
+    const double l_total_cost = l_known_cost + l_default_cost * static_cast<double>(l_count - l_known_count);
+
+    // Cut the prefix sums at each multiple of total / partitions
+    m_partition_bounds.clear();
+    m_partition_bounds.push_back(0);
+    const double l_target = l_total_cost / static_cast<double>(l_partition_count);
+    double l_prefix = 0.0;
+    for (size_t l_index = 0; l_index + 1 < l_count && m_partition_bounds.size() < l_partition_count; ++l_index) {
+        const double l_cost = m_scheduled_agents[l_index]->get_run_cost();
+        l_prefix += l_cost > 0.0 ? l_cost : l_default_cost;
+        if (l_prefix >= l_target * static_cast<double>(m_partition_bounds.size())) {
+            m_partition_bounds.push_back(l_index + 1);
+        }
+    }
+    m_partition_bounds.push_back(l_count);
+}
+
+void GDEnvironment::collect_instant() {
+    m_scheduled_agents.clear();
+    if (m_events.is_empty() || m_events.top().m_time > m_event_horizon) {
+        return;
+    }
+
+    // Time jumps to the next event, an agent runs once per instant
+    m_time = m_events.top().m_time;
+    const auto l_instant = static_cast<uint64_t>(m_turn);
+    while (!m_events.is_empty() && m_events.top().m_time == m_time) {
+        const Event l_event = m_events.pop();
+        GDAgent* l_agent = get(l_event.m_agent);
+        if (!l_agent || l_agent->is_dead()) {
+            continue;
+        }
+        // Not on the wake list: published and delivered now (listed until its wake-ups are consumed)
+        if (l_agent->mark_listed()) {
+            l_agent->publish_observables();
+            if (m_is_using_synchronous_delivery) {
+                l_agent->swap_mailboxes();
+            }
+            m_wake_list.push_back(l_agent);
+        }
+        if (l_agent->begin_event(m_time, l_instant)) {
+            m_scheduled_agents.push_back(l_agent);
+        }
+    }
+}
+
+void GDEnvironment::schedule_event(const AgentHandle p_agent, const double p_delay) {
+    m_event_requests.record(next_order(), {m_time + std::max(p_delay, 0.0), 0, p_agent});
+}
+
+void GDEnvironment::commit_event_requests() {
+    m_event_requests.drain(m_committed_event_requests);
+    for (const auto& l_entry: m_committed_event_requests) {
+        m_events.push({l_entry.m_command.m_time, m_event_sequence++, l_entry.m_command.m_agent});
+    }
+    m_committed_event_requests.clear();
+}
+
+double GDEnvironment::get_next_event_time() const {
+    return m_events.is_empty() ? -1.0 : m_events.top().m_time;
+}
+
+int GDEnvironment::run_until(const double p_time, const int p_emit_every) {
+    int l_instants = 0;
+    m_event_horizon = p_time;
+    for (;;) {
+        // Events scheduled between turns, agents to register (first event at registration)
+        commit_intents();
+        const bool l_has_event = !m_events.is_empty() && m_events.top().m_time <= p_time;
+        if (!l_has_event && m_turn != 0 && !has_new_agents()) {
+            break;
+        }
+        ++l_instants;
+        run_turn(0.0f, p_emit_every > 0 && l_instants % p_emit_every == 0);
+    }
+    m_event_horizon = std::numeric_limits<double>::infinity();
+    m_time = std::max(m_time, p_time);
+    return l_instants;
+}
+
+bool GDEnvironment::has_new_agents() const {
+    bool l_has_new_agents = false;
+    m_new_agents.for_each([&l_has_new_agents](const NewAgent&) {
+        l_has_new_agents = true;
+    });
+    return l_has_new_agents;
+}
+
+Dictionary GDEnvironment::get_barrier_wait_histogram() const {
+    PackedFloat64Array l_bounds;
+    PackedInt64Array l_counts;
+    l_bounds.resize(LatencyHistogram::s_bucket_count);
+    l_counts.resize(LatencyHistogram::s_bucket_count);
+    for (size_t l_bucket = 0; l_bucket < LatencyHistogram::s_bucket_count; ++l_bucket) {
+        l_bounds.set(static_cast<int64_t>(l_bucket), static_cast<double>(LatencyHistogram::get_lower_bound(l_bucket)) / 1000.0);
+        l_counts.set(static_cast<int64_t>(l_bucket), static_cast<int64_t>(m_barrier_waits.get_count(l_bucket)));
+    }
+
+    const uint64_t l_samples = m_barrier_waits.get_sample_count();
+    Dictionary l_histogram;
+    l_histogram["bucket_usec"] = l_bounds;
+    l_histogram["counts"] = l_counts;
+    l_histogram["samples"] = static_cast<int64_t>(l_samples);
+    l_histogram["mean_usec"] = l_samples == 0 ? 0.0 : static_cast<double>(m_barrier_waits.get_total()) / static_cast<double>(l_samples) / 1000.0;
+    l_histogram["p50_usec"] = static_cast<double>(m_barrier_waits.get_quantile(0.5)) / 1000.0;
+    l_histogram["p99_usec"] = static_cast<double>(m_barrier_waits.get_quantile(0.99)) / 1000.0;
+    l_histogram["max_usec"] = static_cast<double>(m_barrier_waits.get_max()) / 1000.0;
+    return l_histogram;
+}
+
+Dictionary GDEnvironment::get_auto_mode_report() const {
+    Dictionary l_report;
+    l_report["is_parallel"] = m_dispatch.is_parallel();
+    l_report["grain"] = static_cast<int64_t>(m_dispatch.get_grain());
+    l_report["agent_cost_usec"] = m_dispatch.get_agent_cost() / 1000.0;
+    l_report["overhead_usec"] = m_dispatch.get_overhead() / 1000.0;
+    l_report["switches"] = static_cast<int64_t>(m_dispatch.get_switch_count());
+    return l_report;
+}
+
+Dictionary GDEnvironment::get_load_report() const {
+    Dictionary l_report;
+    l_report["measured"] = m_is_load_measured;
+    if (m_is_load_measured) {
+        l_report["imbalance"] = m_load_imbalance;
+    }
+    l_report["max_usec"] = m_load_max / 1000.0;
+    l_report["mean_usec"] = m_load_mean / 1000.0;
+    l_report["partitions"] = static_cast<int64_t>(m_load_partition_count);
+    return l_report;
 }
 
 void GDEnvironment::stop() {
@@ -270,19 +839,18 @@ void GDEnvironment::stop() {
 }
 
 std::optional<GDAgent*> GDEnvironment::get(const std::string& p_id) const {
-    const auto& l_it = m_agents.find(p_id);
-    if (l_it == m_agents.end()) {
-        // Must be replaced by true iterator....
-        auto l_new_it = m_new_agents.begin();
-        do {
-            const auto& l_agent = l_new_it.m_node->data;
-            if (l_agent->get_id().utf8().get_data() == p_id) {
-                return l_agent;
-            }
-        } while (++l_new_it.m_node != nullptr);
-        return std::nullopt;
+    if (GDAgent* l_agent = get(get_handle(p_id))) {
+        return l_agent;
     }
-    return l_it->second;
+
+    // Not registered yet
+    std::optional<GDAgent*> l_new_agent;
+    m_new_agents.for_each([&l_new_agent, &p_id](const NewAgent& p_new_agent) {
+        if (!l_new_agent && p_new_agent.m_agent->get_id().utf8().get_data() == p_id) {
+            l_new_agent = p_new_agent.m_agent;
+        }
+    });
+    return l_new_agent;
 }
 
 Variant GDEnvironment::get_agent(const String& p_id) const {
@@ -293,8 +861,43 @@ Variant GDEnvironment::get_agent(const String& p_id) const {
     return Variant();
 }
 
-std::vector<int> GDEnvironment::random_permutation(const size_t p_number) const {
-    std::vector<int> l_numbers(p_number);
+Variant GDEnvironment::get_agent_by_handle(const int64_t p_handle) const {
+    if (GDAgent* l_agent = get(static_cast<AgentHandle>(p_handle))) {
+        return l_agent;
+    }
+    return Variant();
+}
+
+AgentHandle GDEnvironment::get_handle(const std::string& p_id) const {
+    const auto& l_it = m_agents_by_id.find(p_id);
+    if (l_it == m_agents_by_id.end()) {
+        return SlotMap<AgentEntry>::s_invalid_handle;
+    }
+    return l_it->second;
+}
+
+int64_t GDEnvironment::get_agent_handle(const String& p_id) const {
+    return static_cast<int64_t>(get_handle(p_id.utf8().get_data()));
+}
+
+uint64_t GDEnvironment::next_order() {
+    if (const GDAgent* l_agent = GDAgent::get_running_agent(); l_agent && l_agent->get_environment() == this) {
+        return l_agent->next_order();
+    }
+    return (static_cast<uint64_t>(UINT32_MAX) << 32) | m_order_count++;
+}
+
+RandomStream& GDEnvironment::get_random_stream() {
+    GDAgent* l_agent = GDAgent::get_running_agent();
+    if (l_agent && l_agent->get_environment() == this) {
+        return l_agent->get_random_stream();
+    }
+    return m_random;
+}
+
+const std::vector<int>& GDEnvironment::random_permutation(const size_t p_number) {
+    std::vector<int>& l_numbers = m_permutation;
+    l_numbers.resize(p_number);
     if (p_number == 0) {
         return l_numbers;
     }
@@ -302,16 +905,10 @@ std::vector<int> GDEnvironment::random_permutation(const size_t p_number) const
         l_numbers[l_index] = static_cast<int>(l_index);
     }
 
-    size_t l_index = p_number - 1;
-    while (l_index > 1) {
-        const auto l_k = get_random_value<size_t>(0, l_index);
-        if (l_k == l_index) {
-            continue;
-        }
-        const int l_temp = l_numbers[l_index];
-        l_numbers[l_index] = l_numbers[l_k];
-        l_numbers[l_k] = l_temp;
-        l_index--;
+    // Fisher-Yates: every permutation equally likely
+    for (size_t l_index = p_number - 1; l_index > 0; l_index--) {
+        const auto l_k = static_cast<size_t>(m_random.range_int(0, static_cast<int64_t>(l_index)));
+        std::swap(l_numbers[l_index], l_numbers[l_k]);
     }
 
     return l_numbers;
@@ -319,11 +916,12 @@ std::vector<int> GDEnvironment::random_permutation(const size_t p_number) const
 
 std::vector<std::string> GDEnvironment::get_ids(const bool p_alive_only) {
 	std::vector<std::string> l_result;
-	l_result.reserve(m_agents.size());
+	l_result.reserve(m_agent_order.size());
 
-	for (auto& [l_id, l_agent]: m_agents) {
-		if (!p_alive_only || !l_agent->is_dead()) {
-			l_result.push_back(l_id);
+	for (const AgentHandle l_handle: m_agent_order) {
+		const GDAgent* l_agent = get(l_handle);
+		if (l_agent && (!p_alive_only || !l_agent->is_dead())) {
+			l_result.emplace_back(l_agent->get_id().utf8().get_data());
 		}
 	}
 
@@ -332,9 +930,10 @@ std::vector<std::string> GDEnvironment::get_ids(const bool p_alive_only) {
 
 Array GDEnvironment::get_agents_by_label(const String& p_name, bool p_first_only) const {
     Array l_returned_agents;
-    for (const auto& [l_id, l_agent]: m_agents) {
-        if (l_agent->get_label() == p_name) {
-            l_returned_agents.push_back(String(l_id.c_str()));
+    for (const AgentHandle l_handle: m_agent_order) {
+        const GDAgent* l_agent = get(l_handle);
+        if (l_agent && l_agent->get_label() == p_name) {
+            l_returned_agents.push_back(l_agent->get_id());
             if (p_first_only) {
                 break;
             }
@@ -353,8 +952,9 @@ String GDEnvironment::get_first_agent_by_label(const String& p_name) const {
 
 Array GDEnvironment::get_filtered_agents(const String& p_fragment_name, bool p_first_only) const {
     Array l_returned_agents;
-    for (const auto& [l_id, l_agent]: m_agents) {
-        if (l_agent->get_label().find(p_fragment_name) != std::string::npos) {
+    for (const AgentHandle l_handle: m_agent_order) {
+        const GDAgent* l_agent = get(l_handle);
+        if (l_agent && l_agent->get_label().find(p_fragment_name) != -1) {
             l_returned_agents.push_back(l_agent->get_id());
             if (p_first_only) {
                 break;
@@ -365,66 +965,434 @@ Array GDEnvironment::get_filtered_agents(const String& p_fragment_name, bool p_f
 }
 
 std::optional<String> GDEnvironment::get_agent_label(const String& p_id) const {
-    const auto& l_agent = m_agents.find(p_id.utf8().get_data());
-    if (l_agent == m_agents.end()) {
+    const GDAgent* l_agent = get(get_handle(p_id.utf8().get_data()));
+    if (!l_agent) {
         return {};
     }
-    return l_agent.value()->get_label();
+    return l_agent->get_label();
 }
 
-Dictionary GDEnvironment::get_obervables(GDAgent& p_perceiving_agent, const Variant& p_parameters) {
-    Array l_agent_ids;
-    if (m_is_using_custom_see) {
-        l_agent_ids = call("_custom_see", static_cast<Object *>(&p_perceiving_agent), p_parameters);
-    } else {
-        l_agent_ids = default_get_obervables(p_perceiving_agent.get_id());
+bool GDEnvironment::add_observable(const String& p_name, const int p_type) {
+    ObservableColumns::FieldType l_type;
+    switch (p_type) {
+        case Variant::FLOAT:
+            l_type = ObservableColumns::FieldType::Float;
+            break;
+        case Variant::INT:
+            l_type = ObservableColumns::FieldType::Int;
+            break;
+        case Variant::BOOL:
+            l_type = ObservableColumns::FieldType::Bool;
+            break;
+        default:
+            return false;
     }
+    return m_observable_columns.add_field(p_name.utf8().get_data(), l_type) != ObservableColumns::s_no_field;
+}
 
-    Dictionary l_observables;
-    for (int i = 0; i < l_agent_ids.size(); ++i) {
-        const std::string& l_id = String(l_agent_ids[i]).utf8().get_data();
-        if (!m_agents.contains(l_id)) {
+bool GDEnvironment::set_observable(const AgentHandle p_handle, const String& p_name, const Variant& p_value) {
+    const uint32_t l_field = m_observable_columns.find_field(p_name.utf8().get_data());
+    if (l_field == ObservableColumns::s_no_field || !m_agents.contains(p_handle)) {
+        return false;
+    }
+    const uint32_t l_row = SlotMap<AgentEntry>::index_of(p_handle);
+    switch (m_observable_columns.field_type(l_field)) {
+        case ObservableColumns::FieldType::Float:
+            m_observable_columns.set_float(l_field, l_row, static_cast<float>(static_cast<double>(p_value)));
+            break;
+        case ObservableColumns::FieldType::Int:
+            m_observable_columns.set_int(l_field, l_row, static_cast<int32_t>(static_cast<int64_t>(p_value)));
+            break;
+        case ObservableColumns::FieldType::Bool:
+            m_observable_columns.set_int(l_field, l_row, static_cast<bool>(p_value) ? 1 : 0);
+            break;
+    }
+    return true;
+}
+
+Variant GDEnvironment::get_observable(const AgentHandle p_handle, const String& p_name) const {
+    const uint32_t l_field = m_observable_columns.find_field(p_name.utf8().get_data());
+    if (l_field == ObservableColumns::s_no_field || !m_agents.contains(p_handle)) {
+        return {};
+    }
+    return get_observable_value(l_field, SlotMap<AgentEntry>::index_of(p_handle), false);
+}
+
+Variant GDEnvironment::get_observable_value(const uint32_t p_field, const uint32_t p_row, const bool p_is_published) const {
+    switch (m_observable_columns.field_type(p_field)) {
+        case ObservableColumns::FieldType::Float:
+            return p_is_published ? m_observable_columns.get_published_float(p_field, p_row) : m_observable_columns.get_float(p_field, p_row);
+        case ObservableColumns::FieldType::Int:
+            return p_is_published ? m_observable_columns.get_published_int(p_field, p_row) : m_observable_columns.get_int(p_field, p_row);
+        case ObservableColumns::FieldType::Bool:
+            return (p_is_published ? m_observable_columns.get_published_int(p_field, p_row) : m_observable_columns.get_int(p_field, p_row)) != 0;
+    }
+    return {};
+}
+
+Variant GDEnvironment::get_observable_column(const String& p_name) const {
+    const uint32_t l_field = m_observable_columns.find_field(p_name.utf8().get_data());
+    if (l_field == ObservableColumns::s_no_field) {
+        return {};
+    }
+    // Registered agents in scheduling order (handles of removed agents skipped)
+    const auto l_count = static_cast<int64_t>(m_agents.size());
+    int64_t l_index = 0;
+    if (m_observable_columns.field_type(l_field) == ObservableColumns::FieldType::Float) {
+        PackedFloat32Array l_values;
+        l_values.resize(l_count);
+        float* l_data = l_values.ptrw();
+        for (const AgentHandle l_handle: m_agent_order) {
+            if (m_agents.contains(l_handle)) {
+                l_data[l_index++] = m_observable_columns.get_float(l_field, SlotMap<AgentEntry>::index_of(l_handle));
+            }
+        }
+        return l_values;
+    }
+    PackedInt32Array l_values;
+    l_values.resize(l_count);
+    int32_t* l_data = l_values.ptrw();
+    for (const AgentHandle l_handle: m_agent_order) {
+        if (m_agents.contains(l_handle)) {
+            l_data[l_index++] = m_observable_columns.get_int(l_field, SlotMap<AgentEntry>::index_of(l_handle));
+        }
+    }
+    return l_values;
+}
+
+PackedStringArray GDEnvironment::get_agent_ids() const {
+    PackedStringArray l_ids;
+    for (const AgentHandle l_handle: m_agent_order) {
+        if (const GDAgent* l_agent = get(l_handle)) {
+            l_ids.push_back(l_agent->get_id());
+        }
+    }
+    return l_ids;
+}
+
+void GDEnvironment::move_agent(const AgentHandle p_handle, const Vector2& p_position) {
+    if (m_is_running_parallel_turn) {
+        m_pending_moves.record(next_order(), {p_handle, p_position});
+    } else if (m_agents.contains(p_handle)) {
+        m_spatial_index.move(p_handle, p_position.x, p_position.y);
+    }
+}
+
+int64_t GDEnvironment::set_timer(const AgentHandle p_agent, const int p_turns) {
+    const int64_t l_id = ++m_timer_ids;
+    TimerRequest l_request;
+    l_request.m_id = l_id;
+    l_request.m_due = static_cast<uint64_t>(m_turn) + static_cast<uint64_t>(std::max(p_turns, 1));
+    l_request.m_agent = p_agent;
+    m_timer_requests.record(next_order(), std::move(l_request));
+    return l_id;
+}
+
+int64_t GDEnvironment::send_delayed(const String& p_sender_id, const String& p_receiver_id, const String& p_message, const int p_turns, const uint64_t p_order) {
+    const AgentHandle l_receiver = get_handle(p_receiver_id.utf8().get_data());
+    if (l_receiver == SlotMap<AgentEntry>::s_invalid_handle) {
+        return 0;
+    }
+    const int64_t l_id = ++m_timer_ids;
+    TimerRequest l_request;
+    l_request.m_type = TimerRequest::Type::Message;
+    l_request.m_id = l_id;
+    l_request.m_due = static_cast<uint64_t>(m_turn) + static_cast<uint64_t>(std::max(p_turns, 1));
+    l_request.m_agent = l_receiver;
+    l_request.m_payload = std::make_shared<const MessagePayload>(p_sender_id, p_message);
+    m_timer_requests.record(p_order, std::move(l_request));
+    return l_id;
+}
+
+void GDEnvironment::cancel_timer(const int64_t p_id) {
+    TimerRequest l_request;
+    l_request.m_type = TimerRequest::Type::Cancel;
+    l_request.m_id = p_id;
+    m_timer_requests.record(next_order(), std::move(l_request));
+}
+
+void GDEnvironment::commit_timer_requests() {
+    m_timer_requests.drain(m_committed_timer_requests);
+    for (auto& l_entry: m_committed_timer_requests) {
+        TimerRequest& l_request = l_entry.m_command;
+        if (l_request.m_type == TimerRequest::Type::Cancel) {
+            if (const auto& l_handle = m_timer_handles.find(l_request.m_id); l_handle != m_timer_handles.end()) {
+                m_timers.cancel(l_handle->second);
+                m_timer_handles.erase(l_handle);
+            }
             continue;
         }
-        auto* l_agent = m_agents.at(l_id);
-        if (l_agent->is_dead() || l_agent->get_id() == p_perceiving_agent.get_id().utf8().get_data()) {
+        const SlotHandle l_handle = m_timers.schedule(l_request.m_due, {l_request.m_id, l_request.m_agent, std::move(l_request.m_payload)});
+        m_timer_handles.emplace(l_request.m_id, l_handle);
+    }
+    m_committed_timer_requests.clear();
+}
+
+void GDEnvironment::fire_timers() {
+    m_timers.advance(static_cast<uint64_t>(m_turn), [this](TimerEvent& p_event) {
+        m_timer_handles.erase(p_event.m_id);
+        GDAgent* l_agent = get(p_event.m_agent);
+        if (!l_agent || l_agent->is_dead()) {
+            return;
+        }
+        if (p_event.m_payload) {
+            // Environment stamp, after every message of the previous turn, in firing order
+            l_agent->post(Message(std::move(p_event.m_payload), p_event.m_agent, next_order()));
+        } else {
+            l_agent->fire_timer(p_event.m_id);
+        }
+    });
+}
+
+void GDEnvironment::record_intent(const StringName& p_kind, const Variant& p_target, const Variant& p_data) {
+    GDAgent* l_agent = GDAgent::get_running_agent();
+    if (l_agent && l_agent->get_environment() != this) {
+        l_agent = nullptr;
+    }
+    m_script_intents.record(next_order(), {p_kind, l_agent, p_target, p_data});
+}
+
+void GDEnvironment::set_intent_handler(const StringName& p_kind, const Callable& p_apply, const Callable& p_resolver) {
+    for (IntentHandler& l_handler: m_intent_handlers) {
+        if (l_handler.m_kind == p_kind) {
+            l_handler.m_apply = p_apply;
+            l_handler.m_resolver = p_resolver;
+            return;
+        }
+    }
+    m_intent_handlers.push_back({p_kind, p_apply, p_resolver});
+}
+
+const GDEnvironment::IntentHandler* GDEnvironment::get_intent_handler(const StringName& p_kind) const {
+    for (const IntentHandler& l_handler: m_intent_handlers) {
+        if (l_handler.m_kind == p_kind) {
+            return &l_handler;
+        }
+    }
+    return nullptr;
+}
+
+Dictionary GDEnvironment::to_dictionary(const ScriptIntent& p_intent) {
+    Dictionary l_intent;
+    l_intent["kind"] = p_intent.m_kind;
+    l_intent["agent"] = p_intent.m_agent ? Variant(p_intent.m_agent) : Variant();
+    l_intent["target"] = p_intent.m_target;
+    l_intent["data"] = p_intent.m_data;
+    return l_intent;
+}
+
+void GDEnvironment::commit_intents() {
+    commit_timer_requests();
+    commit_event_requests();
+
+    m_script_intents.drain(m_committed_script_intents);
+    if (m_committed_script_intents.empty()) {
+        return;
+    }
+
+    // Conflicts: same kind and same target, in stamp order
+    Dictionary l_conflicts;
+    for (size_t l_index = 0; l_index < m_committed_script_intents.size(); ++l_index) {
+        const ScriptIntent& l_intent = m_committed_script_intents[l_index].m_command;
+        if (l_intent.m_target.get_type() == Variant::NIL) {
+            continue;
+        }
+        Array l_key;
+        l_key.push_back(l_intent.m_kind);
+        l_key.push_back(l_intent.m_target);
+        if (!l_conflicts.has(l_key)) {
+            l_conflicts[l_key] = Array();
+        }
+        Array(l_conflicts[l_key]).push_back(static_cast<int64_t>(l_index));
+    }
+    const Array l_groups = l_conflicts.values();
+    for (int64_t l_group_index = 0; l_group_index < l_groups.size(); ++l_group_index) {
+        const Array l_group = l_groups[l_group_index];
+        if (l_group.size() < 2) {
             continue;
         }
-        const auto& l_observable = l_agent->get_observables();
-        if (l_observable.is_empty()) {
+        const IntentHandler* l_handler = get_intent_handler(m_committed_script_intents[static_cast<int64_t>(l_group[0])].m_command.m_kind);
+        int64_t l_winner = 0;
+        if (l_handler && l_handler->m_resolver.is_valid()) {
+            Array l_intents;
+            for (int64_t l_member = 0; l_member < l_group.size(); ++l_member) {
+                l_intents.push_back(to_dictionary(m_committed_script_intents[static_cast<int64_t>(l_group[l_member])].m_command));
+            }
+            const Variant l_result = l_handler->m_resolver.call(l_intents);
+            l_winner = l_result.get_type() == Variant::INT ? static_cast<int64_t>(l_result) : -1;
+        }
+        for (int64_t l_member = 0; l_member < l_group.size(); ++l_member) {
+            m_committed_script_intents[static_cast<int64_t>(l_group[l_member])].m_command.m_is_accepted = l_member == l_winner;
+        }
+    }
+
+    // Apply the accepted intents
+    for (const auto& l_entry: m_committed_script_intents) {
+        const ScriptIntent& l_intent = l_entry.m_command;
+        if (!l_intent.m_is_accepted) {
             continue;
         }
-        if (p_perceiving_agent.call("_perception_filter", l_agent->get_observables())) {
-            l_observables[l_agent->get_id()] = l_agent->get_observables();
+        const IntentHandler* l_handler = get_intent_handler(l_intent.m_kind);
+        if (!l_handler || !l_handler->m_apply.is_valid()) {
+            UtilityFunctions::push_error("No handler for the intent \"", l_intent.m_kind, "\"");
+            continue;
+        }
+        l_handler->m_apply.call(to_dictionary(l_intent));
+    }
+    m_committed_script_intents.clear();
+}
+
+Array GDEnvironment::query_radius(const Vector2& p_center, const float p_radius) const {
+    Array l_agents_id;
+    m_spatial_index.query_radius(p_center.x, p_center.y, p_radius, [&](const AgentHandle p_handle, float, float) {
+        const GDAgent* l_agent = get(p_handle);
+        if (!l_agent->is_dead()) {
+            l_agents_id.push_back(l_agent->get_id());
+        }
+    });
+    return l_agents_id;
+}
+
+Array GDEnvironment::query_rect(const Rect2& p_rect) const {
+    Array l_agents_id;
+    const Vector2 l_end = p_rect.position + p_rect.size;
+    m_spatial_index.query_rect(p_rect.position.x, p_rect.position.y, l_end.x, l_end.y, [&](const AgentHandle p_handle, float, float) {
+        const GDAgent* l_agent = get(p_handle);
+        if (!l_agent->is_dead()) {
+            l_agents_id.push_back(l_agent->get_id());
+        }
+    });
+    return l_agents_id;
+}
+
+Dictionary GDEnvironment::get_obervables(GDAgent& p_perceiving_agent, const Variant& p_parameters) {
+    Dictionary l_observables;
+    const Variant::Type l_type = p_parameters.get_type();
+    if (!m_is_using_custom_see && p_perceiving_agent.is_placed() && (l_type == Variant::INT || l_type == Variant::FLOAT)) {
+        // see(radius): placed agents around the perceiving agent
+        const Vector2 l_center = p_perceiving_agent.get_spatial_position();
+        m_spatial_index.query_radius(l_center.x, l_center.y, static_cast<float>(p_parameters), [&](const AgentHandle p_handle, float, float) {
+            observe(p_perceiving_agent, *get(p_handle), l_observables);
+        });
+    } else if (m_is_using_custom_see) {
+        const Array l_agent_ids = call("_custom_see", static_cast<Object *>(&p_perceiving_agent), p_parameters);
+        for (int i = 0; i < l_agent_ids.size(); ++i) {
+            if (GDAgent* l_agent = get(get_handle(String(l_agent_ids[i]).utf8().get_data()))) {
+                observe(p_perceiving_agent, *l_agent, l_observables);
+            }
+        }
+    } else {
+        for (const AgentHandle l_handle: m_agent_order) {
+            if (GDAgent* l_agent = get(l_handle)) {
+                observe(p_perceiving_agent, *l_agent, l_observables);
+            }
         }
     }
     return l_observables;
 }
 
+void GDEnvironment::observe(GDAgent& p_perceiving_agent, GDAgent& p_agent, Dictionary& p_observables) const {
+    if (p_agent.is_dead() || &p_agent == &p_perceiving_agent) {
+        return;
+    }
+    const bool l_has_typed_observables = m_observable_columns.field_count() != 0;
+    if (!l_has_typed_observables && p_agent.get_published_observables().is_empty()) {
+        return;
+    }
+
+    // Native filter: no script call, typed observables are not boxed for rejected agents
+    if (p_perceiving_agent.has_perception_filter()) {
+        if (is_passing_perception_filter(p_perceiving_agent, p_agent)) {
+            p_observables[p_agent.get_id()] = get_published_observables(p_agent);
+        }
+        return;
+    }
+
+    const Dictionary l_observable = get_published_observables(p_agent);
+    if (p_perceiving_agent.perception_filter(l_observable)) {
+        p_observables[p_agent.get_id()] = l_observable;
+    }
+}
+
+bool GDEnvironment::is_passing_perception_filter(GDAgent& p_perceiving_agent, const GDAgent& p_agent) const {
+    const std::vector<uint32_t>& l_fields = p_perceiving_agent.get_perception_filter_fields(m_observable_columns);
+    const std::vector<String>& l_keys = p_perceiving_agent.get_perception_filter_keys();
+    const Dictionary& l_published = p_agent.get_published_observables();
+    const uint32_t l_row = SlotMap<AgentEntry>::index_of(p_agent.get_handle());
+
+    const auto l_observable = [&](const uint32_t p_observable, double& p_value) {
+        const uint32_t l_field = l_fields[p_observable];
+        if (l_field != ObservableColumns::s_no_field) {
+            if (m_observable_columns.field_type(l_field) == ObservableColumns::FieldType::Float) {
+                p_value = m_observable_columns.get_published_float(l_field, l_row);
+            } else {
+                p_value = m_observable_columns.get_published_int(l_field, l_row);
+            }
+            return true;
+        }
+        const Variant l_value = l_published.get(l_keys[p_observable], Variant());
+        if (l_value.get_type() != Variant::INT && l_value.get_type() != Variant::FLOAT && l_value.get_type() != Variant::BOOL) {
+            return false;
+        }
+        p_value = static_cast<double>(l_value);
+        return true;
+    };
+    // Positions of the spatial index: fixed during a turn (moves are deferred), the same
+    // ones see(radius) uses, never the live field an agent may be writing
+    const auto l_distance = [&]() {
+        float l_perceiving_x, l_perceiving_y, l_x, l_y;
+        if (!m_spatial_index.get_position(p_perceiving_agent.get_handle(), l_perceiving_x, l_perceiving_y) ||
+            !m_spatial_index.get_position(p_agent.get_handle(), l_x, l_y)) {
+            return std::numeric_limits<double>::infinity();
+        }
+        return std::hypot(static_cast<double>(l_x - l_perceiving_x), static_cast<double>(l_y - l_perceiving_y));
+    };
+    return p_perceiving_agent.get_perception_filter().evaluate(l_observable, l_distance);
+}
+
+Dictionary GDEnvironment::get_published_observables(const GDAgent& p_agent) const {
+    const Dictionary& l_published = p_agent.get_published_observables();
+    if (m_observable_columns.field_count() == 0) {
+        return l_published;
+    }
+
+    Dictionary l_observable;
+    const uint32_t l_row = SlotMap<AgentEntry>::index_of(p_agent.get_handle());
+    for (uint32_t l_field = 0; l_field < m_observable_columns.field_count(); ++l_field) {
+        l_observable[String(m_observable_columns.field_name(l_field).c_str())] = get_observable_value(l_field, l_row, true);
+    }
+    const Array l_keys = l_published.keys();
+    for (int i = 0; i < l_keys.size(); ++i) {
+        l_observable[l_keys[i]] = l_published[l_keys[i]];
+    }
+    l_observable.make_read_only();
+    return l_observable;
+}
+
 Array GDEnvironment::default_get_obervables(const String& p_perceiving_agent_id) const {
     Array l_agents_id;
-
-    // Map id:agent
-    for (auto& [l_id, l_agent]: m_agents) {
-        l_agents_id.push_back(l_id.c_str());
+    for (const AgentHandle l_handle: m_agent_order) {
+        if (const GDAgent* l_agent = get(l_handle)) {
+            l_agents_id.push_back(l_agent->get_id());
+        }
     }
     return l_agents_id;
 }
 
 unsigned int GDEnvironment::randi() {
-    return get_random_value<unsigned int>(0, 4294967295);
+    return get_random_stream().next_u32();
 }
 
 int GDEnvironment::randi_range(int p_min, int p_max) {
-    return get_random_value<int>(p_min, p_max);
+    return static_cast<int>(get_random_stream().range_int(p_min, p_max));
 }
 
 double GDEnvironment::randf() {
-    return get_random_value<double>(0.0, 1.0);
+    return get_random_stream().next_double();
 }
 
 double GDEnvironment::randf_range(double p_min, double p_max) {
-    return get_random_value<double>(p_min, p_max);
+    return get_random_stream().range_double(p_min, p_max);
 }
 
 //###############################################################
@@ -432,7 +1400,7 @@ double GDEnvironment::randf_range(double p_min, double p_max) {
 //###############################################################
 
 void GDEnvironment::simulation_finished() {
-    if (m_environment_mas_mode == EnvironmentMode::Parallel) {
+    if (is_parallel()) {
         call_deferred("emit_signal", "simulation_finished");
     } else {
         call("emit_signal", "simulation_finished");
@@ -440,7 +1408,7 @@ void GDEnvironment::simulation_finished() {
 }
 
 void GDEnvironment::turn_finished(int p_turn) {
-    if (m_environment_mas_mode == EnvironmentMode::Parallel) {
+    if (is_parallel()) {
         call_deferred("emit_signal", "turn_finished", p_turn);
     } else {
         call("emit_signal", "turn_finished", p_turn);
@@ -1,8 +1,8 @@
 #ifndef GDENVIRONMENT
 #define GDENVIRONMENT
 
-#include <future>
-#include <random>
+#include <ctime>
+#include <limits>
 
 #include <godot_cpp/variant/variant.hpp>
 #include <godot_cpp/classes/node.hpp>
@@ -10,14 +10,21 @@
 #include <godot_cpp/core/binder_common.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
 
-#include <ThreadPool/ThreadPool.h>
-
-#include <tsl/ordered_map.h>
-
 #include <nlohmann/json.hpp>
 using json = nlohmann::json;
 
+#include "AdaptiveDispatch.hpp"
+#include "EventQueue.hpp"
+#include "IntentBuffer.hpp"
+#include "LatencyHistogram.hpp"
 #include "MPSCQueue.hpp"
+#include "ObservableColumns.hpp"
+#include "RandomStream.hpp"
+#include "SlotMap.hpp"
+#include "SpatialHash.hpp"
+#include "TaskScheduler.h"
+#include "TimingWheel.hpp"
+#include "WakeList.hpp"
 #include "GDAgent.h"
 
 using namespace godot;
@@ -35,7 +42,9 @@ namespace godot {
     enum EnvironmentMode {
         Parallel,
         Sequential,
-        SequentialRandom
+        SequentialRandom,
+        EventDriven,
+        Auto
     };
 
         // Private attributes
@@ -44,7 +53,10 @@ namespace godot {
         // Exposed
 
         /**
-         * MAS execution mode: Parallel, Sequential, SequentialRandom (sequential but random order)
+         * MAS execution mode: Parallel, Sequential, SequentialRandom (sequential but random order),
+         * EventDriven (agents run at the simulated times they schedule, see schedule_event),
+         * Auto (Parallel semantics, each turn runs on this thread or on the workers, whichever
+         * the measured costs predict faster, see AdaptiveDispatch)
          */
         EnvironmentMode m_environment_mas_mode = EnvironmentMode::Parallel;
 
@@ -58,6 +70,42 @@ namespace godot {
          */
         bool m_is_using_custom_see = false;
 
+        /**
+         * If true, a message sent during turn t is only visible at turn t+1 (mailboxes
+         * are swapped at the turn boundary and sorted by sender), so Parallel and
+         * Sequential runs deliver the same messages in the same order
+         */
+        bool m_is_using_synchronous_delivery = false;
+
+        /**
+         * EventDriven: if true, the agents of events with the same time run in parallel
+         */
+        bool m_is_using_parallel_events = false;
+
+        /**
+         * Maximum number of threads running the agents of this environment (0 means all)
+         */
+        int m_max_workers = 0;
+
+        /**
+         * If true, parallel turns run on Godot's WorkerThreadPool instead of the shared scheduler
+         */
+        bool m_is_using_engine_workers = false;
+
+        /**
+         * If true, the run time of each agent is measured and the agents of a parallel turn
+         * are split into contiguous partitions of equal predicted cost
+         */
+        bool m_is_using_cost_balancing = false;
+
+        /**
+         * Shared scheduler settings: worker count, core pinning mask, spin before
+         * sleeping and thread name prefix. The scheduler is created with the settings
+         * of the first environment running a parallel turn, a later change of any
+         * environment is applied to the running scheduler.
+         */
+        TaskScheduler::Settings m_worker_settings = TaskScheduler::Settings();
+
         // Internal
 
         /**
@@ -65,32 +113,270 @@ namespace godot {
          */
         int m_turn = 0;
 
+        /**
+         * Random stream used outside of the agents turns (stream 0).
+         */
+        RandomStream m_random = RandomStream(static_cast<uint32_t>(m_seed));
+
+        /**
+         * Last random stream given to an agent.
+         */
+        uint32_t m_random_streams = 0;
+
         /**
          * Information that agent can get about the environment.
          */
         json m_environment_data = {};
 
+        /**
+         * Registry entry: the agent and its position in the label index.
+         **/
+        struct AgentEntry {
+            GDAgent* m_agent = nullptr;
+            uint32_t m_label = 0;
+            uint32_t m_label_position = 0;
+        };
+
         /**
          * Agents in the environment.
-		 * Agents: id, content
-		 **/
-        tsl::ordered_map<std::string, GDAgent*> m_agents = tsl::ordered_map<std::string, GDAgent*>();
+         * Agents: handle, entry
+         **/
+        SlotMap<AgentEntry> m_agents = SlotMap<AgentEntry>();
+
+        /**
+         * Agents in the environment, in registration (scheduling) order. Handles of
+         * removed agents stay until they are half of the order (readers skip them).
+         **/
+        std::vector<AgentHandle> m_agent_order = std::vector<AgentHandle>();
+        size_t m_stale_order_count = 0;
+
+        /**
+         * Agents published, swapped and scheduled in a turn (see WakeList).
+         **/
+        WakeList<GDAgent> m_wake_list = WakeList<GDAgent>();
+
+        /**
+         * Last schedule index given, registered agents stopped but not swept yet.
+         **/
+        uint32_t m_schedule_sequence = 0;
+        std::atomic<uint32_t> m_stopped_agent_count = 0;
 
         /**
          * Agents in the environment.
-         * Agents: label, id
+         * Agents: id, handle
+         **/
+        std::unordered_map<std::string, AgentHandle> m_agents_by_id = std::unordered_map<std::string, AgentHandle>();
+
+        /**
+         * Labels of the registered agents.
+         * Labels: label, label ID / label ID, label
+         **/
+        std::unordered_map<std::string, uint32_t> m_label_ids = std::unordered_map<std::string, uint32_t>();
+        std::vector<std::string> m_labels = std::vector<std::string>();
+
+        /**
+         * Agents in the environment (unordered, swap and pop on removal).
+         * Agents: label ID, handles
+         **/
+        std::vector<std::vector<AgentHandle>> m_agents_by_label = std::vector<std::vector<AgentHandle>>();
+
+        /**
+         * New agent: ordering stamp of the add, agent
          **/
-        std::unordered_multimap<std::string, std::string> m_agents_by_label = std::unordered_multimap<std::string, std::string>();
+        struct NewAgent {
+            uint64_t m_order = 0;
+            GDAgent* m_agent = nullptr;
+        };
 
         /**
-         * New agent buffer
+         * New agent buffer (any thread), and the agents being registered, sorted by
+         * stamp so handles, random streams and schedule positions do not depend on
+         * which worker added them first.
          */
-        MPSCQueue<GDAgent*> m_new_agents = MPSCQueue<GDAgent*>();
+        MPSCQueue<NewAgent> m_new_agents = MPSCQueue<NewAgent>();
+        std::vector<NewAgent> m_registered_agents = std::vector<NewAgent>();
 
         /**
-         * Thread pool for agents
+         * Typed observables (schema declared with add_observable), one row per agent slot.
          **/
-        ThreadPool m_pool = ThreadPool(std::thread::hardware_concurrency() == 0 ? 8 : std::thread::hardware_concurrency());
+        ObservableColumns m_observable_columns = ObservableColumns();
+
+        /**
+         * Spatial index of the placed agents (see GDAgent::spatial_position).
+         **/
+        SpatialHash m_spatial_index = SpatialHash();
+
+        /**
+         * Moves made during a Parallel turn, applied after the turn so that
+         * queries of the same turn see the positions of the turn start.
+         **/
+        struct PendingMove {
+            AgentHandle m_handle = 0;
+            Vector2 m_position = Vector2();
+        };
+        IntentBuffer<PendingMove> m_pending_moves = IntentBuffer<PendingMove>();
+        std::vector<IntentBuffer<PendingMove>::Entry> m_committed_moves = std::vector<IntentBuffer<PendingMove>::Entry>();
+
+        /**
+         * Script intent (see record_intent): kind, issuing agent (null outside of the
+         * agents turns), conflict target, user data.
+         **/
+        struct ScriptIntent {
+            StringName m_kind = StringName();
+            GDAgent* m_agent = nullptr;
+            Variant m_target = Variant();
+            Variant m_data = Variant();
+            bool m_is_accepted = true;
+        };
+
+        /**
+         * Intent kind handler: applier and optional conflict resolver.
+         **/
+        struct IntentHandler {
+            StringName m_kind = StringName();
+            Callable m_apply = Callable();
+            Callable m_resolver = Callable();
+        };
+
+        /**
+         * Script intents, their handlers and the intents of the commit being applied.
+         **/
+        IntentBuffer<ScriptIntent> m_script_intents = IntentBuffer<ScriptIntent>();
+        std::vector<IntentHandler> m_intent_handlers = std::vector<IntentHandler>();
+        std::vector<IntentBuffer<ScriptIntent>::Entry> m_committed_script_intents = std::vector<IntentBuffer<ScriptIntent>::Entry>();
+
+        /**
+         * True while agents run in parallel.
+         **/
+        bool m_is_running_parallel_turn = false;
+
+        /**
+         * Timer request (set_timer, send_delayed, cancel_timer), committed with the intents.
+         **/
+        struct TimerRequest {
+            enum class Type : uint8_t {
+                Timer,
+                Message,
+                Cancel
+            };
+            Type m_type = Type::Timer;
+            int64_t m_id = 0;
+            uint64_t m_due = 0;
+            AgentHandle m_agent = 0;
+            MessagePayloadPointer m_payload = nullptr;
+        };
+
+        /**
+         * Scheduled timer: ID, agent (woken up or receiver), message (delayed delivery only).
+         * A delayed message is stamped when it fires: stamps restart every turn.
+         **/
+        struct TimerEvent {
+            int64_t m_id = 0;
+            AgentHandle m_agent = 0;
+            MessagePayloadPointer m_payload = nullptr;
+        };
+
+        /**
+         * Timers and delayed messages by due turn, their wheel handles by ID, pending requests.
+         **/
+        TimingWheel<TimerEvent> m_timers = TimingWheel<TimerEvent>();
+        std::unordered_map<int64_t, SlotHandle> m_timer_handles = std::unordered_map<int64_t, SlotHandle>();
+        IntentBuffer<TimerRequest> m_timer_requests = IntentBuffer<TimerRequest>();
+        std::vector<IntentBuffer<TimerRequest>::Entry> m_committed_timer_requests = std::vector<IntentBuffer<TimerRequest>::Entry>();
+
+        /**
+         * EventDriven: agent action at a simulated time, ordered by time then scheduling order.
+         **/
+        struct Event {
+            double m_time = 0.0;
+            uint64_t m_sequence = 0;
+            AgentHandle m_agent = 0;
+
+            bool operator<(const Event& p_other) const {
+                return m_time < p_other.m_time || (m_time == p_other.m_time && m_sequence < p_other.m_sequence);
+            }
+        };
+
+        /**
+         * EventDriven: pending events, requests of the current instant, simulated time,
+         * last event sequence and latest time processed by run_until.
+         **/
+        EventQueue<Event> m_events = EventQueue<Event>();
+        IntentBuffer<Event> m_event_requests = IntentBuffer<Event>();
+        std::vector<IntentBuffer<Event>::Entry> m_committed_event_requests = std::vector<IntentBuffer<Event>::Entry>();
+        double m_time = 0.0;
+        uint64_t m_event_sequence = 0;
+        double m_event_horizon = std::numeric_limits<double>::infinity();
+
+        /**
+         * Last timer ID given (IDs are opaque, only the ordering stamps order the timers).
+         **/
+        std::atomic<int64_t> m_timer_ids = 0;
+
+        /**
+         * Intents issued outside of the agents turns since the last turn boundary
+         * (environment thread only).
+         **/
+        uint32_t m_order_count = 0;
+
+        /**
+         * Shared work-stealing scheduler, acquired on the first parallel turn
+         **/
+        std::shared_ptr<TaskScheduler> m_scheduler = nullptr;
+
+        /**
+         * Time the environment thread waited for the workers at the end of each parallel turn
+         **/
+        LatencyHistogram m_barrier_waits = LatencyHistogram();
+
+        /**
+         * Auto: cost model
+         **/
+        AdaptiveDispatch m_dispatch = AdaptiveDispatch();
+
+        /**
+         * Time spent in the agents by one worker (or one engine chunk) during the turn,
+         * padded: each slot is written by one thread.
+         **/
+        struct alignas(64) WorkerLoad {
+            uint64_t m_work = 0;
+        };
+        std::vector<WorkerLoad> m_worker_loads = std::vector<WorkerLoad>();
+
+        /**
+         * Cost balancing: first agent of each partition of m_scheduled_agents, then the end.
+         **/
+        std::vector<size_t> m_partition_bounds = std::vector<size_t>();
+
+        /**
+         * Load of the last parallel turn: true if measured per worker (not with the engine
+         * workers), busiest worker / average worker over the workers the job used, busiest
+         * and average work (ns), number of partitions (0 without cost balancing).
+         **/
+        bool m_is_load_measured = false;
+        double m_load_imbalance = 1.0;
+        double m_load_max = 0.0;
+        double m_load_mean = 0.0;
+        size_t m_load_partition_count = 0;
+
+        /**
+         * Engine workers: elapsed time and number of chunks of the running group task,
+         * chunk callable (built on first use, not every turn), pool size (0 until read)
+         **/
+        float m_parallel_elapsed_time = 0.0f;
+        uint32_t m_parallel_chunk_count = 0;
+        Callable m_run_chunk = Callable();
+        size_t m_engine_worker_count = 0;
+
+        /**
+         * Agents scheduled for the current turn
+         **/
+        std::vector<GDAgent*> m_scheduled_agents = std::vector<GDAgent*>();
+
+        /**
+         * Scheduling order of the current turn (SequentialRandom)
+         **/
+        std::vector<int> m_permutation = std::vector<int>();
 
 
         // Methods
@@ -107,6 +393,7 @@ namespace godot {
         // Seed
         void set_seed(const int p_seed) {
             m_seed = p_seed;
+            m_random.reset(static_cast<uint32_t>(m_seed), 0, 0);
         }
         int get_seed() const {
             return m_seed;
@@ -120,6 +407,66 @@ namespace godot {
             return m_is_using_custom_see;
         }
 
+        // Synchronous delivery
+        void set_using_synchronous_delivery(const bool p_is_using_synchronous_delivery) {
+            m_is_using_synchronous_delivery = p_is_using_synchronous_delivery;
+        }
+        bool get_using_synchronous_delivery() const {
+            return m_is_using_synchronous_delivery;
+        }
+
+        // Parallel events
+        void set_using_parallel_events(const bool p_is_using_parallel_events) {
+            m_is_using_parallel_events = p_is_using_parallel_events;
+        }
+        bool get_using_parallel_events() const {
+            return m_is_using_parallel_events;
+        }
+
+        // Workers
+        void set_max_workers(const int p_max_workers) {
+            m_max_workers = std::max(p_max_workers, 0);
+        }
+        int get_max_workers() const {
+            return m_max_workers;
+        }
+        void set_using_engine_workers(const bool p_is_using_engine_workers) {
+            m_is_using_engine_workers = p_is_using_engine_workers;
+        }
+        bool get_using_engine_workers() const {
+            return m_is_using_engine_workers;
+        }
+        void set_using_cost_balancing(const bool p_is_using_cost_balancing) {
+            m_is_using_cost_balancing = p_is_using_cost_balancing;
+        }
+        bool get_using_cost_balancing() const {
+            return m_is_using_cost_balancing;
+        }
+        void set_worker_count(int p_worker_count);
+        int get_worker_count() const {
+            return static_cast<int>(m_worker_settings.m_worker_count);
+        }
+        void set_worker_affinity_mask(int64_t p_worker_affinity_mask);
+        int64_t get_worker_affinity_mask() const {
+            return static_cast<int64_t>(m_worker_settings.m_affinity_mask);
+        }
+        void set_worker_spin_usec(int p_worker_spin_usec);
+        int get_worker_spin_usec() const {
+            return static_cast<int>(m_worker_settings.m_spin_microseconds);
+        }
+        void set_worker_name_prefix(const String& p_worker_name_prefix);
+        String get_worker_name_prefix() const {
+            return String(m_worker_settings.m_thread_name_prefix.c_str());
+        }
+
+        // Spatial index
+        void set_cell_size(const float p_cell_size) {
+            m_spatial_index.set_cell_size(p_cell_size);
+        }
+        float get_cell_size() const {
+            return m_spatial_index.get_cell_size();
+        }
+
         // MAS mode
         EnvironmentMode get_mode() const {
             return m_environment_mas_mode;
@@ -130,6 +477,11 @@ namespace godot {
             return m_turn;
         }
 
+        // Simulated time (EventDriven)
+        double get_time() const {
+            return m_time;
+        }
+
         //###############################################################
         //	Internal
         //###############################################################
@@ -142,8 +494,18 @@ namespace godot {
          * @param p_sender_id The sender ID
          * @param p_receiver_id The receiver label
          * @param p_message The message to be sent
+         * @param p_order Ordering stamp (see GDAgent::next_order)
+         **/
+        void send(const String& p_sender_id, const String& p_receiver_id, const String& p_message, uint64_t p_order) const;
+
+        /**
+         * Sends a message by handle, without any string lookup.
+         * @param p_sender_id The sender ID
+         * @param p_receiver The receiver handle
+         * @param p_message The message to be sent
+         * @param p_order Ordering stamp (see GDAgent::next_order)
          **/
-        void send(const String& p_sender_id, const String& p_receiver_id, const String& p_message) const;
+        void send(const String& p_sender_id, AgentHandle p_receiver, const String& p_message, uint64_t p_order) const;
 
         /**
          * Sends a message by label.
@@ -152,15 +514,42 @@ namespace godot {
          * @param p_message The message to be sent
          * @param p_is_fragment If true search all agent that the label contain "p_receiver_label"
          * @param p_first_only If true send to the first agent found
+         * @param p_order Ordering stamp (see GDAgent::next_order)
          **/
-        void send_by_label(const String& p_sender_id, const String& p_receiver_label, const String& p_message, bool p_is_fragment, bool p_first_only) const;
+        void send_by_label(const String& p_sender_id, const String& p_receiver_label, const String& p_message, bool p_is_fragment, bool p_first_only, uint64_t p_order) const;
 
         /**
          * Send a new message to all agents.
          * @param p_sender_id From
          * @param p_message The message
+         * @param p_order Ordering stamp (see GDAgent::next_order)
+         **/
+        void broadcast(const String& p_sender_id, const String& p_message, uint64_t p_order) const;
+
+        /**
+         * Wake an agent up in p_turns turns: its "_timer" hook is called at that turn.
+         * @param p_agent The agent handle
+         * @param p_turns Delay in turns (at least 1)
+         * @return timer ID
          **/
-        void broadcast(const String& p_sender_id, const String& p_message) const;
+        int64_t set_timer(AgentHandle p_agent, int p_turns);
+
+        /**
+         * Deliver a message in p_turns turns (at the start of that turn).
+         * @param p_sender_id The sender ID
+         * @param p_receiver_id The receiver ID
+         * @param p_message The message
+         * @param p_turns Delay in turns (at least 1)
+         * @param p_order Ordering stamp (see GDAgent::next_order)
+         * @return timer ID, 0 if the receiver is not registered
+         **/
+        int64_t send_delayed(const String& p_sender_id, const String& p_receiver_id, const String& p_message, int p_turns, uint64_t p_order);
+
+        /**
+         * Cancel a timer or a delayed message (nothing if it already fired).
+         * @param p_id Timer ID
+         **/
+        void cancel_timer(int64_t p_id);
 
         /**
          * Adds an agent to the environment.
@@ -185,12 +574,90 @@ namespace godot {
          **/
         void add_nodes_on_tree();
 
+        /**
+         * Register a new agent (handle, ID and label indexes).
+         * @param p_agent The agent
+         **/
+        void register_agent(GDAgent* p_agent);
+
+        /**
+         * Unregister an agent in O(1), the scheduling order is handled by the caller.
+         * @param p_handle The agent handle
+         **/
+        void unregister_agent(AgentHandle p_handle);
+
         /**
          * One turn
          * @param p_elapsed_time time between two calls
          **/
         void one_turn(float p_elapsed_time);
 
+        /**
+         * Run several turns natively (headless batch), without crossing the script
+         * boundary between turns.
+         * @param p_turns Maximum number of turns
+         * @param p_emit_every Emit "turn_finished" every p_emit_every turns and after the last one (0: never)
+         * @param p_stop_if_empty Stop once no agent is alive (or about to be added)
+         * @param p_stop_predicate If valid, called with the finished turn after each turn, stop when it returns true
+         * @param p_elapsed_time Time given to the agents for each turn
+         * @return number of turns run
+         **/
+        int run_turns(int p_turns, int p_emit_every, bool p_stop_if_empty, const Callable& p_stop_predicate, float p_elapsed_time);
+
+        /**
+         * EventDriven: process the events until a simulated time (included), then
+         * jump to that time.
+         * @param p_time Simulated time
+         * @param p_emit_every Emit "turn_finished" every p_emit_every instants (0: never)
+         * @return number of instants processed (one per distinct event time)
+         **/
+        int run_until(double p_time, int p_emit_every);
+
+        /**
+         * EventDriven: run an agent in p_delay simulated time (safe from any thread,
+         * applied with the intents).
+         * @param p_agent The agent handle
+         * @param p_delay Delay (0: at the current time, after the current instant)
+         **/
+        void schedule_event(AgentHandle p_agent, double p_delay);
+
+        /**
+         * EventDriven: time of the next event.
+         * @return time, -1 if no event is pending
+         **/
+        [[nodiscard]] double get_next_event_time() const;
+
+        /**
+         * Time the environment thread waited for the workers at the end of the
+         * parallel turns since the last reset.
+         * @return {"bucket_usec": lower bound of each bucket, "counts": waits per bucket,
+         * "samples", "mean_usec", "p50_usec", "p99_usec", "max_usec"}
+         **/
+        [[nodiscard]] Dictionary get_barrier_wait_histogram() const;
+
+        /**
+         * Auto: current choice and cost estimates.
+         * @return {"is_parallel", "grain", "agent_cost_usec", "overhead_usec", "switches"}
+         **/
+        [[nodiscard]] Dictionary get_auto_mode_report() const;
+
+        /**
+         * Load balance of the last parallel turn.
+         * @return {"measured": true if the load was measured per worker, "imbalance": busiest
+         * worker / average worker of the job (1 is perfect, only if measured), "max_usec",
+         * "mean_usec", "partitions": cost-balanced partitions (0 if not balanced)}. With the
+         * engine workers, the load is measured per chunk and there is no imbalance (the pool
+         * does not tell which thread ran a chunk).
+         **/
+        [[nodiscard]] Dictionary get_load_report() const;
+
+        /**
+         * Forget the barrier waits recorded so far.
+         **/
+        void reset_barrier_wait_histogram() {
+            m_barrier_waits.clear();
+        }
+
         /**
          * Stops the simulation.
          **/
@@ -205,25 +672,61 @@ namespace godot {
         Variant get_agent(const String& p_id) const;
 
         /**
-         * Return random number
-         * @param p_min min value
-         * @param p_max max value
-         * @return random value between min and max
+         * Get an agent by handle.
+         * @param p_handle Agent handle
+         * @return Agent pointer, nullptr if the handle is not valid (agent removed)
          **/
-        template<class T>
-        [[nodiscard]] T get_random_value(T p_min, T p_max) const {
-            static std::default_random_engine s_seeder(static_cast<int>(m_seed));
-            static std::mt19937 s_generator(s_seeder());
-            std::uniform_real_distribution<T> l_dist(p_min, p_max);
-            return l_dist(s_generator);
+        [[nodiscard]] GDAgent* get(AgentHandle p_handle) const {
+            const AgentEntry* l_entry = m_agents.get(p_handle);
+            return l_entry ? l_entry->m_agent : nullptr;
         }
+        [[nodiscard]] Variant get_agent_by_handle(int64_t p_handle) const;
+
+        /**
+         * Get the handle of a registered agent.
+         * @param p_id Agent ID
+         * @return Agent handle, 0 if not registered
+         **/
+        [[nodiscard]] AgentHandle get_handle(const std::string& p_id) const;
+        [[nodiscard]] int64_t get_agent_handle(const String& p_id) const;
+
+        /**
+         * Ordering stamp of the next intent: the one of the running agent during its
+         * turn, after all agents otherwise (e.g. environment script between turns).
+         * The environment stamp path (no running agent) must only be called from the
+         * environment thread: its counter is not atomic.
+         * @return ordering stamp
+         **/
+        [[nodiscard]] uint64_t next_order();
+
+        /**
+         * Put an agent on the wake list (any thread, see GDAgent::request_run).
+         * @param p_agent Registered agent, just marked as listed
+         **/
+        void list_awake_agent(GDAgent* p_agent) {
+            m_wake_list.list(p_agent);
+        }
+
+        /**
+         * A registered agent stopped (any thread), it is swept at the next turn start.
+         **/
+        void agent_stopped() {
+            m_stopped_agent_count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /**
+         * Random stream of the caller: the stream of the running agent during its
+         * turn (whatever the worker), the environment stream otherwise.
+         * @return random stream
+         **/
+        [[nodiscard]] RandomStream& get_random_stream();
 
         /**
          * Return a vector (p_number length) of random index.
-         * Fisher-Yates shuffle.
+         * Fisher-Yates shuffle, the vector is reused by the next call.
          * @param p_number Number of value in the returned vector
          **/
-        [[nodiscard]] std::vector<int> random_permutation(size_t p_number) const;
+        [[nodiscard]] const std::vector<int>& random_permutation(size_t p_number);
 
         /**
 		 * Get all ids
@@ -271,12 +774,120 @@ namespace godot {
 
         /**
          * Get the list of observable agents for an agent and its perception filter.
+         * Reads the observables published at the turn start (no copy, no race with
+         * agents updating their observables during the turn).
          * @param p_perceiving_agent Perceiving agent
          * @param p_parameter Parameters
          **/
         [[nodiscard]] Dictionary get_obervables(GDAgent& p_perceiving_agent, const Variant& p_parameter);
         [[nodiscard]] Array default_get_obervables(const String& p_perceiving_agent_id) const;
 
+        /**
+         * Declare a typed observable, every agent gets the field (0 by default).
+         * @param p_name Field name
+         * @param p_type Variant type: TYPE_FLOAT, TYPE_INT or TYPE_BOOL
+         * @return false if the type is not supported or the name is used with another type
+         **/
+        bool add_observable(const String& p_name, int p_type);
+
+        /**
+         * Set/get the typed observable of an agent (current value, not the published one).
+         * @param p_handle Agent handle
+         * @param p_name Field name
+         * @param p_value Value
+         * @return false if the field is not declared or the agent not registered
+         **/
+        bool set_observable(AgentHandle p_handle, const String& p_name, const Variant& p_value);
+        [[nodiscard]] Variant get_observable(AgentHandle p_handle, const String& p_name) const;
+
+        /**
+         * All values of a typed observable, in scheduling order (see get_agent_ids).
+         * @param p_name Field name
+         * @return PackedFloat32Array (TYPE_FLOAT) or PackedInt32Array (TYPE_INT, TYPE_BOOL), null if not declared
+         **/
+        [[nodiscard]] Variant get_observable_column(const String& p_name) const;
+
+        /**
+         * IDs of the registered agents, in scheduling order.
+         * @return IDs
+         **/
+        [[nodiscard]] PackedStringArray get_agent_ids() const;
+
+        /**
+         * Typed observable as a Variant.
+         * @param p_field Field ID
+         * @param p_row Row (slot index)
+         * @param p_is_published If true, read the value published at the turn start
+         * @return value
+         **/
+        [[nodiscard]] Variant get_observable_value(uint32_t p_field, uint32_t p_row, bool p_is_published) const;
+
+        /**
+         * Update the position of an agent in the spatial index (deferred to the end
+         * of the turn in Parallel).
+         * @param p_handle Agent handle
+         * @param p_position New position
+         **/
+        void move_agent(AgentHandle p_handle, const Vector2& p_position);
+
+        /**
+         * Record an intent, applied after the agents of the turn ran (or at the next
+         * turn start if recorded between turns) by the handler of its kind, in
+         * ordering stamp order. Safe from any thread.
+         * @param p_kind Intent kind (see set_intent_handler)
+         * @param p_target Conflict target: intents of the same kind on the same target conflict, null never conflicts
+         * @param p_data User data
+         **/
+        void record_intent(const StringName& p_kind, const Variant& p_target, const Variant& p_data);
+
+        /**
+         * Set the handler of an intent kind.
+         * @param p_kind Intent kind
+         * @param p_apply Called with each accepted intent (Dictionary: kind, agent, target, data)
+         * @param p_resolver Called with the conflicting intents (Array, stamp order), returns the index of the accepted one (-1: none). If not valid, the first intent wins
+         **/
+        void set_intent_handler(const StringName& p_kind, const Callable& p_apply, const Callable& p_resolver);
+
+        /**
+         * Agents in a disc (border included), placed agents only.
+         * @param p_center Center
+         * @param p_radius Radius
+         * @return IDs of the agents
+         **/
+        [[nodiscard]] Array query_radius(const Vector2& p_center, float p_radius) const;
+
+        /**
+         * Agents in a rectangle (border included), placed agents only.
+         * @param p_rect Rectangle
+         * @return IDs of the agents
+         **/
+        [[nodiscard]] Array query_rect(const Rect2& p_rect) const;
+
+        /**
+         * Add the observables of an agent if the perceiving agent can see it.
+         * @param p_perceiving_agent Perceiving agent
+         * @param p_agent Observed agent
+         * @param p_observables Observables seen (id: observables)
+         **/
+        void observe(GDAgent& p_perceiving_agent, GDAgent& p_agent, Dictionary& p_observables) const;
+
+        /**
+         * Evaluate the native perception filter of the perceiving agent. Distances use
+         * the positions of the spatial index (as of the turn start during a turn).
+         * @param p_perceiving_agent Perceiving agent (with a native filter)
+         * @param p_agent Observed agent
+         * @return True if the observed agent passes the filter
+         **/
+        [[nodiscard]] bool is_passing_perception_filter(GDAgent& p_perceiving_agent, const GDAgent& p_agent) const;
+
+        /**
+         * Published observables of an agent, typed ones first. With typed observables,
+         * a new Dictionary is built per call (perception still allocates).
+         * @param p_agent Observed agent
+         * @return read-only observables
+         **/
+        [[nodiscard]] Dictionary get_published_observables(const GDAgent& p_agent) const;
+
         /**
          * Return random number (long)
          * @return random value between 0 and 4294967295
@@ -349,6 +960,144 @@ namespace godot {
          **/
         void turn_finished(int p_turn);
 
+        // Protected methods
+    protected:
+
+        //###############################################################
+        //	Subclass hooks
+        //###############################################################
+
+        /**
+         * Apply the intents collected while agents were running. Called when no agent
+         * runs: at the start of a turn (intents issued between turns) and right after
+         * the agents of the turn. Overrides must call it (script intents).
+         **/
+        virtual void commit_intents();
+
+        /**
+         * A dead agent is about to be unregistered and deleted.
+         * @param p_agent The agent
+         **/
+        virtual void agent_removed(GDAgent* p_agent) {}
+
+        // Private methods
+    private:
+
+        /**
+         * One turn.
+         * @param p_elapsed_time time between two calls
+         * @param p_is_emitting If true, emit "turn_finished"
+         **/
+        void run_turn(float p_elapsed_time, bool p_is_emitting);
+
+        /**
+         * True if an agent is alive or waiting to be added.
+         * @return true if not empty
+         **/
+        [[nodiscard]] bool has_alive_agents() const;
+
+        /**
+         * True if agents run on several threads in the current mode.
+         * @return true if parallel
+         **/
+        [[nodiscard]] bool is_parallel() const {
+            return m_environment_mas_mode == EnvironmentMode::Parallel || m_environment_mas_mode == EnvironmentMode::Auto || (m_environment_mas_mode == EnvironmentMode::EventDriven && m_is_using_parallel_events);
+        }
+
+        /**
+         * Run m_scheduled_agents with the shared scheduler (or the engine workers, or on
+         * this thread when Auto predicts it faster), then apply the deferred moves.
+         * @param p_elapsed_time time between two calls (ignored in EventDriven, see GDAgent::begin_event)
+         **/
+        void run_scheduled_agents_in_parallel(float p_elapsed_time);
+
+        /**
+         * Change one setting of the running shared scheduler, if any, keeping the
+         * settings applied by the other environments. The scheduler queues the change
+         * until its next job, so agents may call it during a parallel turn.
+         * @param p_change Function applied to the settings
+         **/
+        template<typename F>
+        void configure_scheduler(F&& p_change) {
+            p_change(m_worker_settings);
+            if (m_scheduler) {
+                TaskScheduler::Settings l_settings = m_scheduler->get_settings();
+                p_change(l_settings);
+                m_scheduler->configure(l_settings);
+            }
+        }
+
+        /**
+         * Number of threads of the engine WorkerThreadPool. The pool does not expose it,
+         * it is sized once from the project setting (-1 means one thread per core).
+         * @return number of engine workers
+         **/
+        size_t get_engine_worker_count();
+
+        /**
+         * Run m_scheduled_agents[p_begin, p_end).
+         * @param p_begin First agent
+         * @param p_end End
+         * @param p_elapsed_time time between two calls (ignored in EventDriven)
+         * @param p_slot Slot of m_worker_loads of the calling thread
+         **/
+        void run_scheduled_range(size_t p_begin, size_t p_end, float p_elapsed_time, size_t p_slot);
+
+        /**
+         * Cost balancing: split m_scheduled_agents into contiguous partitions of equal
+         * predicted cost (prefix sums of the agents run costs; agents never measured
+         * count as the average).
+         * @param p_partition_count Number of partitions wanted
+         **/
+        void build_partitions(size_t p_partition_count);
+
+        /**
+         * Engine workers: run one chunk of m_scheduled_agents (group task element).
+         * @param p_chunk Chunk index, in [0, m_parallel_chunk_count)
+         **/
+        void run_scheduled_chunk(uint32_t p_chunk);
+
+        /**
+         * EventDriven: pop the events of the next instant into m_scheduled_agents and
+         * move the simulated time to it.
+         **/
+        void collect_instant();
+
+        /**
+         * Apply the event requests.
+         **/
+        void commit_event_requests();
+
+        /**
+         * True if agents wait to be registered.
+         * @return true if agents are pending
+         **/
+        [[nodiscard]] bool has_new_agents() const;
+
+        /**
+         * Apply the timer requests.
+         **/
+        void commit_timer_requests();
+
+        /**
+         * Fire the timers due at the current turn (wake-ups, delayed messages).
+         **/
+        void fire_timers();
+
+        /**
+         * Handler of an intent kind.
+         * @param p_kind Intent kind
+         * @return handler, nullptr if not set
+         **/
+        [[nodiscard]] const IntentHandler* get_intent_handler(const StringName& p_kind) const;
+
+        /**
+         * Script intent as a Dictionary (kind, agent, target, data).
+         * @param p_intent Intent
+         * @return Dictionary
+         **/
+        [[nodiscard]] static Dictionary to_dictionary(const ScriptIntent& p_intent);
+
     };
 }
 
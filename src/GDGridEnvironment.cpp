@@ -0,0 +1,226 @@
+#include "GDGridEnvironment.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <godot_cpp/core/class_db.hpp>
+
+using namespace godot;
+
+//###############################################################
+//	Godot methods
+//###############################################################
+
+void GDGridEnvironment::_bind_methods() {
+    // Methods
+    ClassDB::bind_method(D_METHOD("is_inside"), &GDGridEnvironment::is_inside);
+    ClassDB::bind_method(D_METHOD("is_free"), &GDGridEnvironment::is_free);
+    ClassDB::bind_method(D_METHOD("get_agent_at"), &GDGridEnvironment::get_agent_at);
+    ClassDB::bind_method(D_METHOD("get_agent_cell"), &GDGridEnvironment::get_agent_cell);
+    ClassDB::bind_method(D_METHOD("get_neighbors", "cell", "neighborhood", "range"), &GDGridEnvironment::get_neighbors, DEFVAL(Moore), DEFVAL(1));
+    ClassDB::bind_method(D_METHOD("get_free_neighbors", "cell", "neighborhood", "range"), &GDGridEnvironment::get_free_neighbors, DEFVAL(Moore), DEFVAL(1));
+    ClassDB::bind_method(D_METHOD("get_neighbor_agents", "cell", "neighborhood", "range"), &GDGridEnvironment::get_neighbor_agents, DEFVAL(Moore), DEFVAL(1));
+
+    ClassDB::bind_method(D_METHOD("request_move"), &GDGridEnvironment::request_move);
+    ClassDB::bind_method(D_METHOD("request_spawn"), &GDGridEnvironment::request_spawn);
+    ClassDB::bind_method(D_METHOD("request_removal"), &GDGridEnvironment::request_removal);
+
+    // Enum
+    BIND_ENUM_CONSTANT(Moore);
+    BIND_ENUM_CONSTANT(VonNeumann);
+
+    // Properties
+    ClassDB::bind_method(D_METHOD("set_grid_size"), &GDGridEnvironment::set_grid_size);
+    ClassDB::bind_method(D_METHOD("get_grid_size"), &GDGridEnvironment::get_grid_size);
+    ClassDB::add_property(
+            "GDGridEnvironment",
+            PropertyInfo(Variant::VECTOR2I, "grid_size", PROPERTY_HINT_NONE, "Grid size (cells)"),
+            "set_grid_size",
+            "get_grid_size"
+    );
+}
+
+//###############################################################
+//	Get/Set
+//###############################################################
+
+void GDGridEnvironment::set_grid_size(const Vector2i& p_grid_size) {
+    if (!m_agent_cells.empty() || p_grid_size.x <= 0 || p_grid_size.y <= 0) {
+        return;
+    }
+    m_grid_size = p_grid_size;
+    m_cells.assign(static_cast<size_t>(m_grid_size.x) * static_cast<size_t>(m_grid_size.y), nullptr);
+}
+
+//###############################################################
+//	Queries
+//###############################################################
+
+bool GDGridEnvironment::is_free(const Vector2i& p_cell) const {
+    if (!is_inside(p_cell)) {
+        return false;
+    }
+    // A dead agent keeps its cell until it is removed, but the cell can be taken
+    const GDAgent* l_agent = m_cells[index_of(p_cell)];
+    return l_agent == nullptr || l_agent->is_dead();
+}
+
+Variant GDGridEnvironment::get_agent_at(const Vector2i& p_cell) const {
+    if (!is_inside(p_cell)) {
+        return {};
+    }
+    GDAgent* l_agent = m_cells[index_of(p_cell)];
+    if (!l_agent || l_agent->is_dead()) {
+        return {};
+    }
+    return l_agent;
+}
+
+Vector2i GDGridEnvironment::get_agent_cell(const Variant& p_agent) const {
+    const auto* l_agent = dynamic_cast<GDAgent*>(p_agent.operator Object *());
+    const auto& l_cell = m_agent_cells.find(l_agent);
+    if (l_cell == m_agent_cells.end()) {
+        return {-1, -1};
+    }
+    return cell_of(l_cell->second);
+}
+
+Array GDGridEnvironment::get_neighbors(const Vector2i& p_cell, const int p_neighborhood, const int p_range) const {
+    Array l_cells;
+    for_each_neighbor(p_cell, p_neighborhood, p_range, [&](const Vector2i& p_neighbor) {
+        l_cells.push_back(p_neighbor);
+    });
+    return l_cells;
+}
+
+Array GDGridEnvironment::get_free_neighbors(const Vector2i& p_cell, const int p_neighborhood, const int p_range) const {
+    Array l_cells;
+    for_each_neighbor(p_cell, p_neighborhood, p_range, [&](const Vector2i& p_neighbor) {
+        if (is_free(p_neighbor)) {
+            l_cells.push_back(p_neighbor);
+        }
+    });
+    return l_cells;
+}
+
+Array GDGridEnvironment::get_neighbor_agents(const Vector2i& p_cell, const int p_neighborhood, const int p_range) const {
+    Array l_agents_id;
+    for_each_neighbor(p_cell, p_neighborhood, p_range, [&](const Vector2i& p_neighbor) {
+        const GDAgent* l_agent = m_cells[index_of(p_neighbor)];
+        if (l_agent && !l_agent->is_dead()) {
+            l_agents_id.push_back(l_agent->get_id());
+        }
+    });
+    return l_agents_id;
+}
+
+//###############################################################
+//	Intents
+//###############################################################
+
+void GDGridEnvironment::request_move(const Variant& p_agent, const Vector2i& p_cell) {
+    auto* l_agent = dynamic_cast<GDAgent*>(p_agent.operator Object *());
+    if (l_agent) {
+        m_intents.record(next_order(), {IntentType::Move, l_agent, p_cell});
+    }
+}
+
+void GDGridEnvironment::request_spawn(const Variant& p_agent, const Vector2i& p_cell) {
+    auto* l_agent = dynamic_cast<GDAgent*>(p_agent.operator Object *());
+    if (l_agent) {
+        m_intents.record(next_order(), {IntentType::Spawn, l_agent, p_cell});
+    }
+}
+
+void GDGridEnvironment::request_removal(const Variant& p_agent) {
+    auto* l_agent = dynamic_cast<GDAgent*>(p_agent.operator Object *());
+    if (l_agent) {
+        m_intents.record(next_order(), {IntentType::Removal, l_agent, Vector2i()});
+    }
+}
+
+//###############################################################
+//	Subclass hooks
+//###############################################################
+
+void GDGridEnvironment::commit_intents() {
+    // Sorted by stamp: the first intent wins whatever the thread that issued it
+    m_intents.drain(m_committed_intents);
+    for (const auto& l_entry: m_committed_intents) {
+        const Intent& l_committed = l_entry.m_command;
+        GDAgent* l_agent = l_committed.m_agent;
+        switch (l_committed.m_type) {
+            case IntentType::Move:
+                if (!l_agent->is_dead() && m_agent_cells.count(l_agent) != 0 && is_free(l_committed.m_cell)) {
+                    occupy(l_agent, l_committed.m_cell);
+                }
+                break;
+            case IntentType::Spawn: {
+                // Agents of another environment are not placed here (agent_removed would never vacate them)
+                const GDEnvironment* l_environment = l_agent->get_environment();
+                if (l_environment && l_environment != this) {
+                    break;
+                }
+                if (!l_agent->is_dead() && m_agent_cells.count(l_agent) == 0 && is_free(l_committed.m_cell)) {
+                    occupy(l_agent, l_committed.m_cell);
+                    // Agents already in the environment are only placed
+                    if (!l_environment) {
+                        add(l_agent);
+                    }
+                } else if (!l_environment) {
+                    m_rejected_agents.push_back(l_agent);
+                }
+                break;
+            }
+            case IntentType::Removal:
+                if (!l_agent->is_dead()) {
+                    vacate(l_agent);
+                    l_agent->stop();
+                }
+                break;
+        }
+    }
+    m_committed_intents.clear();
+
+    // Rejected spawns that were never added: nobody else owns them
+    std::sort(m_rejected_agents.begin(), m_rejected_agents.end());
+    m_rejected_agents.erase(std::unique(m_rejected_agents.begin(), m_rejected_agents.end()), m_rejected_agents.end());
+    for (GDAgent* l_agent: m_rejected_agents) {
+        if (!l_agent->get_environment()) {
+            memdelete(l_agent);
+        }
+    }
+    m_rejected_agents.clear();
+
+    GDEnvironment::commit_intents();
+}
+
+void GDGridEnvironment::agent_removed(GDAgent* p_agent) {
+    vacate(p_agent);
+}
+
+//###############################################################
+//	Internals
+//###############################################################
+
+void GDGridEnvironment::occupy(GDAgent* p_agent, const Vector2i& p_cell) {
+    const uint32_t l_index = index_of(p_cell);
+    if (GDAgent* l_dead = m_cells[l_index]) {
+        m_agent_cells.erase(l_dead);
+    }
+    vacate(p_agent);
+    m_cells[l_index] = p_agent;
+    m_agent_cells[p_agent] = l_index;
+    p_agent->set_spatial_position(Vector2(static_cast<float>(p_cell.x), static_cast<float>(p_cell.y)));
+}
+
+void GDGridEnvironment::vacate(const GDAgent* p_agent) {
+    const auto& l_cell = m_agent_cells.find(p_agent);
+    if (l_cell == m_agent_cells.end()) {
+        return;
+    }
+    if (m_cells[l_cell->second] == p_agent) {
+        m_cells[l_cell->second] = nullptr;
+    }
+    m_agent_cells.erase(l_cell);
+}
@@ -0,0 +1,296 @@
+#ifndef GDGRIDENVIRONMENT
+#define GDGRIDENVIRONMENT
+
+#include <unordered_map>
+#include <vector>
+
+#include <godot_cpp/variant/variant.hpp>
+#include <godot_cpp/classes/node.hpp>
+#include <godot_cpp/core/binder_common.hpp>
+
+#include "IntentBuffer.hpp"
+#include "GDAgent.h"
+#include "GDEnvironment.h"
+
+using namespace godot;
+
+namespace godot {
+
+    /**
+     * Godot grid environment: agents live on the cells of a 2D grid, one agent per cell.
+     *
+     * Agents do not change the grid directly. They request moves, spawns and removals
+     * (intents) from any thread during the turn; the intents are applied after the
+     * agents ran, in ordering stamp order (agent position at the turn start, then
+     * issue order), so conflicts (e.g. two agents moving to the same cell) always
+     * resolve the same way whatever the mode and the number of workers: the first
+     * intent wins, the others are rejected.
+     */
+    class GDGridEnvironment : public GDEnvironment {
+    GDCLASS(GDGridEnvironment, GDEnvironment)
+
+    public:
+    enum Neighborhood {
+        Moore,
+        VonNeumann
+    };
+
+        // Private attributes
+    private:
+        /**
+         * Intent kinds
+         **/
+        enum class IntentType : uint8_t {
+            Move,
+            Spawn,
+            Removal
+        };
+
+        /**
+         * Intent: agent, target cell
+         **/
+        struct Intent {
+            IntentType m_type = IntentType::Move;
+            GDAgent* m_agent = nullptr;
+            Vector2i m_cell = Vector2i();
+        };
+
+        // Exposed
+
+        /**
+         * Grid size (cells)
+         **/
+        Vector2i m_grid_size = Vector2i(50, 50);
+
+        // Internal
+
+        /**
+         * Occupancy: agent on each cell (row major), nullptr if free.
+         **/
+        std::vector<GDAgent*> m_cells = std::vector<GDAgent*>(50 * 50, nullptr);
+
+        /**
+         * Cell of each agent on the grid.
+         **/
+        std::unordered_map<const GDAgent*, uint32_t> m_agent_cells = std::unordered_map<const GDAgent*, uint32_t>();
+
+        /**
+         * Intents issued since the last commit.
+         **/
+        IntentBuffer<Intent> m_intents = IntentBuffer<Intent>();
+
+        /**
+         * Intents of the commit being applied (kept to reuse the allocation).
+         **/
+        std::vector<IntentBuffer<Intent>::Entry> m_committed_intents = std::vector<IntentBuffer<Intent>::Entry>();
+
+        /**
+         * Spawned agents rejected by the commit being applied.
+         **/
+        std::vector<GDAgent*> m_rejected_agents = std::vector<GDAgent*>();
+
+        // Methods
+    public:
+
+        //###############################################################
+        //	Get/Set
+        //###############################################################
+
+        /**
+         * Set the grid size, the grid must be empty.
+         **/
+        void set_grid_size(const Vector2i& p_grid_size);
+        Vector2i get_grid_size() const {
+            return m_grid_size;
+        }
+
+        //###############################################################
+        //	Queries (no change during the turn)
+        //###############################################################
+
+        /**
+         * True if the cell is in the grid.
+         * @param p_cell Cell
+         * @return True if the cell is in the grid
+         **/
+        [[nodiscard]] bool is_inside(const Vector2i& p_cell) const {
+            return p_cell.x >= 0 && p_cell.y >= 0 && p_cell.x < m_grid_size.x && p_cell.y < m_grid_size.y;
+        }
+
+        /**
+         * True if the cell is in the grid and free (or held by an agent stopped this turn).
+         * @param p_cell Cell
+         * @return True if free
+         **/
+        [[nodiscard]] bool is_free(const Vector2i& p_cell) const;
+
+        /**
+         * Agent on a cell.
+         * @param p_cell Cell
+         * @return Agent or null
+         **/
+        [[nodiscard]] Variant get_agent_at(const Vector2i& p_cell) const;
+
+        /**
+         * Cell of an agent.
+         * @param p_agent Agent
+         * @return Cell, (-1, -1) if the agent is not on the grid
+         **/
+        [[nodiscard]] Vector2i get_agent_cell(const Variant& p_agent) const;
+
+        /**
+         * Cells around a cell, inside the grid.
+         * @param p_cell Center cell
+         * @param p_neighborhood Moore (8 cells at range 1) or VonNeumann (4 cells at range 1)
+         * @param p_range Range
+         * @return Cells
+         **/
+        [[nodiscard]] Array get_neighbors(const Vector2i& p_cell, int p_neighborhood = Moore, int p_range = 1) const;
+
+        /**
+         * Free cells around a cell.
+         * @param p_cell Center cell
+         * @param p_neighborhood Moore or VonNeumann
+         * @param p_range Range
+         * @return Cells
+         **/
+        [[nodiscard]] Array get_free_neighbors(const Vector2i& p_cell, int p_neighborhood = Moore, int p_range = 1) const;
+
+        /**
+         * Agents around a cell.
+         * @param p_cell Center cell
+         * @param p_neighborhood Moore or VonNeumann
+         * @param p_range Range
+         * @return IDs of the agents
+         **/
+        [[nodiscard]] Array get_neighbor_agents(const Vector2i& p_cell, int p_neighborhood = Moore, int p_range = 1) const;
+
+        //###############################################################
+        //	Intents (applied at the end of the turn)
+        //###############################################################
+
+        /**
+         * Move an agent on the grid to a free cell.
+         * @param p_agent Agent
+         * @param p_cell Target cell
+         **/
+        void request_move(const Variant& p_agent, const Vector2i& p_cell);
+
+        /**
+         * Add a new agent on a free cell (or place an agent already added), a new
+         * agent is freed if the cell is taken. Dead agents and agents of another
+         * environment are ignored.
+         * @param p_agent New agent
+         * @param p_cell Cell
+         **/
+        void request_spawn(const Variant& p_agent, const Vector2i& p_cell);
+
+        /**
+         * Stop an agent and free its cell.
+         * @param p_agent Agent
+         **/
+        void request_removal(const Variant& p_agent);
+
+        //###############################################################
+        //	Constructor
+        //###############################################################
+
+        /**
+         * Constructor
+         */
+        GDGridEnvironment() = default;
+
+        /**
+         * Destructor
+         */
+        ~GDGridEnvironment() override = default;
+
+        //###############################################################
+        //	Godot methods
+        //###############################################################
+
+        /**
+         * Bind methods, signals etc.
+         */
+        static void _bind_methods();
+
+        // Protected methods
+    protected:
+
+        //###############################################################
+        //	Subclass hooks
+        //###############################################################
+
+        /**
+         * Apply the intents in ordering stamp order, then the script intents.
+         **/
+        void commit_intents() override;
+
+        /**
+         * Free the cell of a removed agent.
+         * @param p_agent The agent
+         **/
+        void agent_removed(GDAgent* p_agent) override;
+
+        // Private methods
+    private:
+
+        /**
+         * Index of a cell in m_cells.
+         * @param p_cell Cell (inside the grid)
+         * @return index
+         **/
+        [[nodiscard]] uint32_t index_of(const Vector2i& p_cell) const {
+            return static_cast<uint32_t>(p_cell.y * m_grid_size.x + p_cell.x);
+        }
+
+        /**
+         * Cell of an index of m_cells.
+         * @param p_index Index
+         * @return cell
+         **/
+        [[nodiscard]] Vector2i cell_of(const uint32_t p_index) const {
+            return {static_cast<int32_t>(p_index % m_grid_size.x), static_cast<int32_t>(p_index / m_grid_size.x)};
+        }
+
+        /**
+         * Put an agent on a cell (available), removing it from its previous cell.
+         * @param p_agent Agent
+         * @param p_cell Cell
+         **/
+        void occupy(GDAgent* p_agent, const Vector2i& p_cell);
+
+        /**
+         * Remove an agent from the grid.
+         * @param p_agent Agent
+         **/
+        void vacate(const GDAgent* p_agent);
+
+        /**
+         * Call p_function(cell) on each cell of the neighborhood inside the grid.
+         * @param p_cell Center cell
+         * @param p_neighborhood Moore or VonNeumann
+         * @param p_range Range
+         * @param p_function Function
+         **/
+        template<typename F>
+        void for_each_neighbor(const Vector2i& p_cell, const int p_neighborhood, const int p_range, F&& p_function) const {
+            for (int l_y = p_cell.y - p_range; l_y <= p_cell.y + p_range; ++l_y) {
+                for (int l_x = p_cell.x - p_range; l_x <= p_cell.x + p_range; ++l_x) {
+                    const Vector2i l_cell(l_x, l_y);
+                    if ((l_x == p_cell.x && l_y == p_cell.y) || !is_inside(l_cell)) {
+                        continue;
+                    }
+                    if (p_neighborhood == VonNeumann && std::abs(l_x - p_cell.x) + std::abs(l_y - p_cell.y) > p_range) {
+                        continue;
+                    }
+                    p_function(l_cell);
+                }
+            }
+        }
+    };
+}
+
+VARIANT_ENUM_CAST(GDGridEnvironment::Neighborhood)
+
+#endif // GDGRIDENVIRONMENT
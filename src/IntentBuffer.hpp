@@ -0,0 +1,197 @@
+/**************************************************************************
+ *                                                                        *
+ *  Description: MinimalAgent multi-agent framework                       *
+ *  Website:     https://github.com/jferdelyi/MinimalAgent                *
+ *  Copyright:   (c) 2023-Today, Jean-François Erdelyi                    *
+ *                                                                        *
+ *  CPP version of ActressMAS by Florin Leon                              *
+ *  https://github.com/florinleon/ActressMas                              *
+ *                                                                        *
+ *  This program is free software; you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General License as published by         *
+ *  the Free Software Foundation. This program is distributed in the      *
+ *  hope that it will be useful, but WITHOUT ANY WARRANTY; without even   *
+ *  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR   *
+ *  PURPOSE. See the GNU General License for more details.                *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/**
+ * Intent (command) buffer: mutations requested while agents run, applied later in
+ * a deterministic order.
+ *
+ * Each thread records into its own buffer (no lock, no shared cache line after the
+ * first record of a thread), so agents running in parallel never contend. Once all
+ * threads are done (after the turn barrier), drain merges the buffers and sorts the
+ * intents by ordering stamp (see GDAgent::next_order): the result does not depend
+ * on the number of workers nor on which worker ran which agent. Stamps must be
+ * unique (intents with the same stamp are applied in any order).
+ *
+ * record may be called from any thread; drain, reserve, clear and is_empty only
+ * while no thread records.
+ */
+template<typename T>
+class IntentBuffer final {
+public:
+    /**
+     * Intent: ordering stamp, command
+     */
+    struct Entry {
+        std::uint64_t m_order = 0;
+        T m_command = T();
+    };
+
+private:
+    /**
+     * Buffer of one thread, linked in a push-only list.
+     */
+    struct ThreadBuffer {
+        std::thread::id m_thread = std::thread::id();
+        std::vector<Entry> m_entries = std::vector<Entry>();
+        ThreadBuffer* m_next = nullptr;
+    };
+
+    /**
+     * Last buffer used by a thread, the ID tells which IntentBuffer it belongs to
+     * (addresses may be reused, IDs are not).
+     */
+    struct ThreadCache {
+        std::uint64_t m_owner = 0;
+        ThreadBuffer* m_buffer = nullptr;
+    };
+
+    /**
+     * Thread buffers
+     */
+    std::atomic<ThreadBuffer*> m_buffers = nullptr;
+
+    /**
+     * Unique ID of this intent buffer
+     */
+    const std::uint64_t m_id = next_id();
+
+    static std::uint64_t next_id() {
+        static std::atomic<std::uint64_t> s_ids = 0;
+        return ++s_ids;
+    }
+
+    static ThreadCache& thread_cache() {
+        thread_local ThreadCache s_cache;
+        return s_cache;
+    }
+
+public:
+    IntentBuffer() = default;
+
+    ~IntentBuffer() {
+        ThreadBuffer* l_buffer = m_buffers.load(std::memory_order_acquire);
+        while (l_buffer) {
+            ThreadBuffer* l_next = l_buffer->m_next;
+            delete l_buffer;
+            l_buffer = l_next;
+        }
+    }
+
+    /**
+     * Record an intent.
+     * @param p_order Ordering stamp
+     * @param p_command Command
+     */
+    void record(const std::uint64_t p_order, T p_command) {
+        local_buffer().m_entries.push_back({p_order, std::move(p_command)});
+    }
+
+    /**
+     * Move all intents to p_entries (appended), sorted by ordering stamp.
+     * Thread buffers keep their capacity: once warm, recording and draining do not allocate.
+     * @param p_entries Output
+     */
+    void drain(std::vector<Entry>& p_entries) {
+        const std::size_t l_first = p_entries.size();
+        for (ThreadBuffer* l_buffer = m_buffers.load(std::memory_order_acquire); l_buffer; l_buffer = l_buffer->m_next) {
+            std::move(l_buffer->m_entries.begin(), l_buffer->m_entries.end(), std::back_inserter(p_entries));
+            l_buffer->m_entries.clear();
+        }
+        // Stamps are unique: in place sort, no temporary buffer
+        std::sort(p_entries.begin() + static_cast<std::ptrdiff_t>(l_first), p_entries.end(), [](const Entry& p_left, const Entry& p_right) {
+            return p_left.m_order < p_right.m_order;
+        });
+    }
+
+    /**
+     * True if no intent is recorded.
+     * @return true if empty
+     */
+    [[nodiscard]] bool is_empty() const {
+        for (ThreadBuffer* l_buffer = m_buffers.load(std::memory_order_acquire); l_buffer; l_buffer = l_buffer->m_next) {
+            if (!l_buffer->m_entries.empty()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Reserve room for p_capacity intents in each thread buffer created so far.
+     * @param p_capacity Intents per thread
+     */
+    void reserve(const std::size_t p_capacity) {
+        for (ThreadBuffer* l_buffer = m_buffers.load(std::memory_order_acquire); l_buffer; l_buffer = l_buffer->m_next) {
+            l_buffer->m_entries.reserve(p_capacity);
+        }
+    }
+
+    /**
+     * Remove all intents.
+     */
+    void clear() {
+        for (ThreadBuffer* l_buffer = m_buffers.load(std::memory_order_acquire); l_buffer; l_buffer = l_buffer->m_next) {
+            l_buffer->m_entries.clear();
+        }
+    }
+
+    // Delete copy constructor
+    IntentBuffer(const IntentBuffer&) = delete;
+
+    IntentBuffer& operator=(const IntentBuffer&) = delete;
+
+private:
+    /**
+     * Buffer of the calling thread, created on its first record.
+     * @return thread buffer
+     */
+    ThreadBuffer& local_buffer() {
+        ThreadCache& l_cache = thread_cache();
+        if (l_cache.m_owner == m_id) {
+            return *l_cache.m_buffer;
+        }
+
+        // Few threads: a linear search is enough
+        const std::thread::id l_thread = std::this_thread::get_id();
+        ThreadBuffer* l_head = m_buffers.load(std::memory_order_acquire);
+        ThreadBuffer* l_buffer = l_head;
+        while (l_buffer && l_buffer->m_thread != l_thread) {
+            l_buffer = l_buffer->m_next;
+        }
+        if (!l_buffer) {
+            l_buffer = new ThreadBuffer;
+            l_buffer->m_thread = l_thread;
+            l_buffer->m_next = l_head;
+            while (!m_buffers.compare_exchange_weak(l_buffer->m_next, l_buffer, std::memory_order_release, std::memory_order_acquire)) {
+            }
+        }
+        l_cache.m_owner = m_id;
+        l_cache.m_buffer = l_buffer;
+        return *l_buffer;
+    }
+};
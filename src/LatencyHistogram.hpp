@@ -0,0 +1,118 @@
+/**************************************************************************
+ *                                                                        *
+ *  Description: MinimalAgent multi-agent framework                       *
+ *  Website:     https://github.com/jferdelyi/MinimalAgent                *
+ *  Copyright:   (c) 2023-Today, Jean-François Erdelyi                    *
+ *                                                                        *
+ *  CPP version of ActressMAS by Florin Leon                              *
+ *  https://github.com/florinleon/ActressMas                              *
+ *                                                                        *
+ *  This program is free software; you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General License as published by         *
+ *  the Free Software Foundation. This program is distributed in the      *
+ *  hope that it will be useful, but WITHOUT ANY WARRANTY; without even   *
+ *  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR   *
+ *  PURPOSE. See the GNU General License for more details.                *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Histogram of durations in nanoseconds with power of two buckets: bucket i
+ * counts the durations in [2^i, 2^(i+1)) ns (bucket 0 also counts 0 ns, the
+ * last bucket everything above). Recording is a couple of instructions, so it
+ * can stay on in every turn. Not thread-safe: one recording thread.
+ */
+class LatencyHistogram final {
+public:
+    /**
+     * Number of buckets, the last one starts at about 2.1 s.
+     */
+    static constexpr size_t s_bucket_count = 32;
+
+private:
+    std::array<uint64_t, s_bucket_count> m_counts{};
+    uint64_t m_sample_count = 0;
+    uint64_t m_total = 0;
+    uint64_t m_max = 0;
+
+public:
+    /**
+     * Add a duration.
+     * @param p_nanoseconds duration
+     */
+    void record(const uint64_t p_nanoseconds) {
+        const size_t l_bucket = p_nanoseconds == 0 ? 0 : static_cast<size_t>(std::bit_width(p_nanoseconds)) - 1;
+        ++m_counts[std::min(l_bucket, s_bucket_count - 1)];
+        ++m_sample_count;
+        m_total += p_nanoseconds;
+        m_max = std::max(m_max, p_nanoseconds);
+    }
+
+    /**
+     * Remove all durations.
+     */
+    void clear() {
+        m_counts.fill(0);
+        m_sample_count = 0;
+        m_total = 0;
+        m_max = 0;
+    }
+
+    /**
+     * Number of durations in a bucket.
+     * @param p_bucket bucket index
+     * @return count
+     */
+    [[nodiscard]] uint64_t get_count(const size_t p_bucket) const {
+        return m_counts[p_bucket];
+    }
+
+    /**
+     * Lower bound of a bucket.
+     * @param p_bucket bucket index
+     * @return nanoseconds
+     */
+    [[nodiscard]] static uint64_t get_lower_bound(const size_t p_bucket) {
+        return p_bucket == 0 ? 0 : uint64_t(1) << p_bucket;
+    }
+
+    [[nodiscard]] uint64_t get_sample_count() const {
+        return m_sample_count;
+    }
+
+    [[nodiscard]] uint64_t get_total() const {
+        return m_total;
+    }
+
+    [[nodiscard]] uint64_t get_max() const {
+        return m_max;
+    }
+
+    /**
+     * Approximate quantile (upper bound of the bucket holding it).
+     * @param p_quantile quantile in [0, 1]
+     * @return nanoseconds, 0 if empty
+     */
+    [[nodiscard]] uint64_t get_quantile(const double p_quantile) const {
+        if (m_sample_count == 0) {
+            return 0;
+        }
+        const auto l_rank = static_cast<uint64_t>(std::clamp(p_quantile, 0.0, 1.0) * static_cast<double>(m_sample_count - 1));
+        uint64_t l_seen = 0;
+        for (size_t l_bucket = 0; l_bucket < s_bucket_count; ++l_bucket) {
+            l_seen += m_counts[l_bucket];
+            if (l_seen > l_rank) {
+                return l_bucket + 1 < s_bucket_count ? std::min(get_lower_bound(l_bucket + 1), m_max) : m_max;
+            }
+        }
+        return m_max;
+    }
+};
@@ -19,10 +19,137 @@
 #pragma once
 
 #include <atomic>
+#include <mutex>
 #include <queue>
 #include "cereal/types/queue.hpp" // Serialize queue
 
 
+/**
+ * Node pool shared by all the queues of a node type.
+ * Each thread keeps its own free list (no synchronization on the fast path), a
+ * global list guarded by a mutex balances the threads that mostly dequeue (and
+ * release nodes) with the threads that mostly enqueue (and acquire nodes). Nodes
+ * move between both in batches, so steady-state messaging does not allocate.
+ * Node must have an atomic "next" member, reused as the free list link.
+ */
+template<typename Node>
+class MPSCNodePool {
+    /**
+     * Free list
+     */
+    struct FreeList {
+        Node* m_head = nullptr;
+        size_t m_size = 0;
+
+        void push(Node* p_node) {
+            p_node->next.store(m_head, std::memory_order_relaxed);
+            m_head = p_node;
+            ++m_size;
+        }
+
+        Node* pop() {
+            Node* l_node = m_head;
+            m_head = l_node->next.load(std::memory_order_relaxed);
+            --m_size;
+            return l_node;
+        }
+    };
+
+    /**
+     * Global free list (batches only)
+     */
+    struct SharedFreeList : FreeList {
+        std::mutex m_mutex;
+
+        ~SharedFreeList() {
+            while (this->m_head != nullptr) {
+                delete this->pop();
+            }
+        }
+    };
+
+    /**
+     * Thread free list, given back to the global list when the thread exits
+     */
+    struct LocalFreeList : FreeList {
+        ~LocalFreeList() {
+            SharedFreeList& l_shared = shared_free_list();
+            std::unique_lock l_lock(l_shared.m_mutex);
+            while (this->m_head != nullptr) {
+                l_shared.push(this->pop());
+            }
+        }
+    };
+
+    /**
+     * Local free list size limit and transfer batch size
+     */
+    static constexpr size_t s_local_capacity = 1024;
+    static constexpr size_t s_batch_size = 256;
+
+    static SharedFreeList& shared_free_list() {
+        static SharedFreeList s_shared_free_list;
+        return s_shared_free_list;
+    }
+
+    static LocalFreeList& local_free_list() {
+        // The global list must be destroyed after every thread list
+        shared_free_list();
+        thread_local LocalFreeList s_local_free_list;
+        return s_local_free_list;
+    }
+
+public:
+    /**
+     * Get a node (only allocates when all free lists are empty)
+     * @return node
+     */
+    static Node* acquire() {
+        LocalFreeList& l_local = local_free_list();
+        if (l_local.m_head == nullptr) {
+            SharedFreeList& l_shared = shared_free_list();
+            std::unique_lock l_lock(l_shared.m_mutex);
+            for (size_t l_index = 0; l_index < s_batch_size && l_shared.m_head != nullptr; ++l_index) {
+                l_local.push(l_shared.pop());
+            }
+        }
+        if (l_local.m_head == nullptr) {
+            return new Node;
+        }
+        return l_local.pop();
+    }
+
+    /**
+     * Fill the global free list up to p_count nodes (the following acquires do not
+     * allocate while the free lists hold enough nodes)
+     * @param p_count nodes
+     */
+    static void reserve(const size_t p_count) {
+        SharedFreeList& l_shared = shared_free_list();
+        std::unique_lock l_lock(l_shared.m_mutex);
+        while (l_shared.m_size < p_count) {
+            l_shared.push(new Node);
+        }
+    }
+
+    /**
+     * Give back a node
+     * @param p_node node
+     */
+    static void release(Node* p_node) {
+        LocalFreeList& l_local = local_free_list();
+        l_local.push(p_node);
+        if (l_local.m_size > s_local_capacity) {
+            SharedFreeList& l_shared = shared_free_list();
+            std::unique_lock l_lock(l_shared.m_mutex);
+            for (size_t l_index = 0; l_index < s_batch_size; ++l_index) {
+                l_shared.push(l_local.pop());
+            }
+        }
+    }
+};
+
+
 /**
  * MPSC (Multiple Producer Single Consumer) lock free queue from CPP Benchmark (serializable)
  * https://github.com/chronoxor/CppBenchmark/blob/master/examples/lockfree/mpsc-queue.hpp
@@ -37,6 +164,7 @@ class MPSCQueue {
         std::atomic<MPSCQueueNode*> next;
     };
     typedef char MPSCQueuePad[64];
+    using MPSCQueuePool = MPSCNodePool<MPSCQueueNode>;
 
     /**
      * Head of the queue
@@ -52,29 +180,12 @@ class MPSCQueue {
 
 public:
 
-    // Iterator
-    class MPSCQueueIterator {
-    public:
-        MPSCQueueNode* m_node;
-
-        explicit MPSCQueueIterator(MPSCQueueNode* p_node) :
-                m_node(p_node) {}
-
-        const MPSCQueueNode* next() {
-            return m_node->next;
-        }
-
-        const MPSCQueueIterator& operator++() {
-            return m_node->next.load(std::memory_order_acquire);;
-        }
-    };
-
     /**
      * MPSC (Multiple Producer Single Consumer) lock free queue constructor
      */
     MPSCQueue() :
             m_head_pad{},
-            m_head(new MPSCQueueNode),
+            m_head(MPSCQueuePool::acquire()),
             m_tail_pad{},
             m_tail(m_head.load(std::memory_order_relaxed)) {
         MPSCQueueNode* l_front = m_head.load(std::memory_order_relaxed);
@@ -87,8 +198,8 @@ public:
     ~MPSCQueue() {
         T l_output;
         while (this->dequeue(l_output)) {}
-        const MPSCQueueNode* l_front = m_head.load(std::memory_order_relaxed);
-        delete l_front;
+        MPSCQueueNode* l_front = m_head.load(std::memory_order_relaxed);
+        MPSCQueuePool::release(l_front);
     }
 
     /**
@@ -96,13 +207,26 @@ public:
      * @param p_input_item new item
      */
     void enqueue(const T& p_input_item) {
-        auto* l_node = new MPSCQueueNode;
-        l_node->data = p_input_item;
+        T l_item = p_input_item;
+        enqueue(std::move(l_item));
+    }
+    void enqueue(T&& p_input_item) {
+        auto* l_node = MPSCQueuePool::acquire();
+        l_node->data = std::move(p_input_item);
         l_node->next.store(nullptr, std::memory_order_relaxed);
         MPSCQueueNode* l_prev_head = m_head.exchange(l_node, std::memory_order_acq_rel);
         l_prev_head->next.store(l_node, std::memory_order_release);
     }
 
+    /**
+     * Make sure p_count nodes are free for the queues of this item type (shared by
+     * all of them), e.g. before enqueuing from several threads.
+     * @param p_count nodes
+     */
+    static void reserve(const size_t p_count) {
+        MPSCQueuePool::reserve(p_count);
+    }
+
     /**
      * Dequeue last item
      * @param p_output_item last item
@@ -116,12 +240,34 @@ public:
             return false;
         }
 
-        p_output_item = l_next->data;
+        // l_next becomes the stub, its data is not needed anymore
+        p_output_item = std::move(l_next->data);
         m_tail.store(l_next, std::memory_order_release);
-        delete l_tail;
+        MPSCQueuePool::release(l_tail);
         return true;
     }
 
+    /**
+     * True if nothing is queued (from the consumer side)
+     * @return true if empty
+     */
+    [[nodiscard]] bool is_empty() const {
+        return m_tail.load(std::memory_order_relaxed)->next.load(std::memory_order_acquire) == nullptr;
+    }
+
+    /**
+     * Visit the queued items (from the consumer side, no concurrent dequeue)
+     * @param p_function function called on each item
+     */
+    template<class Function>
+    void for_each(Function&& p_function) const {
+        const MPSCQueueNode* l_node = m_tail.load(std::memory_order_relaxed)->next.load(std::memory_order_acquire);
+        while (l_node != nullptr) {
+            p_function(l_node->data);
+            l_node = l_node->next.load(std::memory_order_acquire);
+        }
+    }
+
     /**
      * Serialize queue
      * @param p_archive archive to store queue
@@ -153,14 +299,6 @@ public:
         }
     }
 
-    MPSCQueueIterator begin() const {
-        return MPSCQueueIterator(m_head.load(std::memory_order_relaxed));
-    }
-
-    MPSCQueueIterator end() const {
-        return MPSCQueueIterator(m_tail.load(std::memory_order_relaxed));
-    }
-
     // Delete copy constructor
     MPSCQueue(const MPSCQueue&) = delete;
 
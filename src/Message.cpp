@@ -22,9 +22,8 @@
 
 using namespace godot;
 
-Message::Message(String  p_sender, String p_receiver, const String& p_message, const MessageBinaryFormat& p_binary_format) :
+MessagePayload::MessagePayload(String p_sender, const String& p_message, const MessageBinaryFormat& p_binary_format) :
     m_sender(std::move(p_sender)),
-    m_receiver(std::move(p_receiver)),
     m_binary_format(p_binary_format),
     m_message(p_message)
     //m_binary_message(Message::to_binary(p_message.utf8(), m_binary_format))
@@ -40,24 +39,35 @@ Message::Message(String  p_sender, String p_receiver, const String& p_message, c
 	}
 }*/
 
-Message::Message() :
+MessagePayload::MessagePayload() :
 		m_sender(),
-		m_receiver(),
 		m_binary_format(MessageBinaryFormat::MessagePack),
 		m_binary_message() {
 }
 
-json Message::content() const {
+json MessagePayload::content() const {
 	return Message::to_json(m_binary_message, m_binary_format);
 }
 
-String Message::to_string() const {
+const String& MessagePayload::to_string() const {
 	//return content().dump().c_str();
     return m_message;
 }
 
+Message::Message(MessagePayloadPointer p_payload, const SlotHandle p_receiver, const std::uint64_t p_order) :
+    m_payload(std::move(p_payload)),
+    m_receiver(p_receiver),
+    m_order(p_order) {
+}
+
+Message::Message() :
+		m_payload(),
+		m_receiver(0),
+		m_order(0) {
+}
+
 String Message::format() const {
-	return "[" + m_sender + " -> " + m_receiver + "]: " + to_string();
+	return "[" + get_sender() + " -> " + String::num_int64(static_cast<int64_t>(m_receiver)) + "]: " + to_string();
 }
 
 json Message::to_json(const std::vector<std::uint8_t>& p_binary_message, const MessageBinaryFormat& p_binary_format) {
@@ -22,6 +22,8 @@
 
 #include "nlohmann/json.hpp"
 
+#include "SlotMap.hpp"
+
 using json = nlohmann::json;
 
 namespace godot {
@@ -34,11 +36,10 @@ enum class MessageBinaryFormat {
 };
 
 /**
- * A message that the agents use to communicate. In an agent-based system, the
- * communication between the agents is exclusively performed by exchanging
- * messages.
+ * Immutable content of a message, shared by all its recipients (broadcast,
+ * send by label): one allocation and one copy of the strings per sending.
  **/
-class Message final {
+class MessagePayload final {
 
 protected:
     /**
@@ -46,11 +47,6 @@ protected:
      **/
     String m_sender;
 
-    /**
-     * Receiver.
-     **/
-    String m_receiver;
-
     /**
      * Binary format.
      **/
@@ -64,31 +60,24 @@ protected:
 
 public:
     /**
-     * Message.
+     * Message payload.
      * @param p_sender Sender.
-     * @param p_receiver Receiver.
      * @param p_message Message.
      * @param p_binary_format Binary format used.
      **/
-    Message(String p_sender, String p_receiver, const String& p_message, const MessageBinaryFormat& p_binary_format = MessageBinaryFormat::RAW);
-    Message();
+    MessagePayload(String p_sender, const String& p_message, const MessageBinaryFormat& p_binary_format = MessageBinaryFormat::RAW);
+    MessagePayload();
 
     /**
      * Nothing to delete.
      **/
-    /*virtual*/ ~Message() = default;
+    /*virtual*/ ~MessagePayload() = default;
 
     /**
      * Get sender.
      * @return Sender.
      **/
-    [[nodiscard]] String get_sender() const { return m_sender; }
-
-    /**
-     * Get receiver.
-     * @return Receiver.
-     **/
-    [[nodiscard]] String get_receiver() const { return m_receiver; }
+    [[nodiscard]] const String& get_sender() const { return m_sender; }
 
     /**
      * Get binary message.
@@ -112,7 +101,92 @@ public:
      * Format message to string.
      * @return string message from JSON
      **/
-    [[nodiscard]] String to_string() const;
+    [[nodiscard]] const String& to_string() const;
+
+    // Delete copy constructor
+    MessagePayload(const MessagePayload&) = delete;
+
+    MessagePayload& operator=(MessagePayload&) = delete;
+};
+
+// Message payload pointer
+using MessagePayloadPointer = std::shared_ptr<const MessagePayload>;
+
+/**
+ * A message that the agents use to communicate. In an agent-based system, the
+ * communication between the agents is exclusively performed by exchanging
+ * messages.
+ * This is the per-recipient envelope: a pointer to the shared payload, the
+ * receiver and the ordering stamp. It is stored by value in the mailboxes.
+ **/
+class Message final {
+
+protected:
+    /**
+     * Shared content.
+     **/
+    MessagePayloadPointer m_payload;
+
+    /**
+     * Receiver.
+     **/
+    SlotHandle m_receiver;
+
+    /**
+     * Ordering stamp: sender position (high 32 bits), sending order (low 32 bits).
+     **/
+    std::uint64_t m_order;
+
+public:
+    /**
+     * Message.
+     * @param p_payload Shared content.
+     * @param p_receiver Receiver handle.
+     * @param p_order Ordering stamp.
+     **/
+    Message(MessagePayloadPointer p_payload, SlotHandle p_receiver, std::uint64_t p_order = 0);
+    Message();
+
+    /**
+     * Nothing to delete.
+     **/
+    /*virtual*/ ~Message() = default;
+
+    /**
+     * Get payload.
+     * @return Payload.
+     **/
+    [[nodiscard]] const MessagePayloadPointer& get_payload() const { return m_payload; }
+
+    /**
+     * Get sender.
+     * @return Sender.
+     **/
+    [[nodiscard]] const String& get_sender() const { return m_payload->get_sender(); }
+
+    /**
+     * Get receiver.
+     * @return Receiver handle.
+     **/
+    [[nodiscard]] SlotHandle get_receiver() const { return m_receiver; }
+
+    /**
+     * Get ordering stamp.
+     * @return Ordering stamp.
+     **/
+    [[nodiscard]] std::uint64_t get_order() const { return m_order; }
+
+    /**
+     * Get message.
+     * @return message JSON
+     **/
+    [[nodiscard]] json content() const { return m_payload->content(); }
+
+    /**
+     * Format message to string.
+     * @return string message from JSON
+     **/
+    [[nodiscard]] const String& to_string() const { return m_payload->to_string(); }
 
     /**
      * Format message.
@@ -128,13 +202,5 @@ public:
      **/
     static std::vector<std::uint8_t> to_binary(const json& p_message, const MessageBinaryFormat& p_binary_format = MessageBinaryFormat::MessagePack);
     static json to_json(const std::vector<std::uint8_t>& p_message, const MessageBinaryFormat& p_binary_format = MessageBinaryFormat::MessagePack);
-
-    // Delete copy constructor
-    Message(const Message&) = delete;
-
-    Message& operator=(Message&) = delete;
 };
-
-// Message pointer
-using MessagePointer = std::shared_ptr<const Message>;
 }
@@ -0,0 +1,208 @@
+/**************************************************************************
+ *                                                                        *
+ *  Description: MinimalAgent multi-agent framework                       *
+ *  Website:     https://github.com/jferdelyi/MinimalAgent                *
+ *  Copyright:   (c) 2023-Today, Jean-François Erdelyi                    *
+ *                                                                        *
+ *  CPP version of ActressMAS by Florin Leon                              *
+ *  https://github.com/florinleon/ActressMas                              *
+ *                                                                        *
+ *  This program is free software; you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General License as published by         *
+ *  the Free Software Foundation. This program is distributed in the      *
+ *  hope that it will be useful, but WITHOUT ANY WARRANTY; without even   *
+ *  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR   *
+ *  PURPOSE. See the GNU General License for more details.                *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Typed observables: a schema of named fields, each stored in a contiguous column
+ * with one row per agent slot (see SlotMap::index_of).
+ *
+ * Columns are double-buffered like the Dictionary observables: agents write the
+ * back columns during the turn, perception reads the front columns published at
+ * the turn start.
+ */
+class ObservableColumns final {
+public:
+    /**
+     * Field type, booleans are stored in integer columns.
+     */
+    enum class FieldType : std::uint8_t {
+        Float,
+        Int,
+        Bool
+    };
+
+    static constexpr std::uint32_t s_no_field = UINT32_MAX;
+
+private:
+    /**
+     * Field: type and column (in the float or int columns)
+     */
+    struct Field {
+        FieldType m_type = FieldType::Float;
+        std::uint32_t m_column = 0;
+    };
+
+    /**
+     * Schema: field name, field ID / field ID, field
+     */
+    std::unordered_map<std::string, std::uint32_t> m_field_ids;
+    std::vector<std::string> m_field_names;
+    std::vector<Field> m_fields;
+
+    /**
+     * Back columns (written during the turn)
+     */
+    std::vector<std::vector<float>> m_float_columns;
+    std::vector<std::vector<std::int32_t>> m_int_columns;
+
+    /**
+     * Front columns (published at the turn start)
+     */
+    std::vector<std::vector<float>> m_published_float_columns;
+    std::vector<std::vector<std::int32_t>> m_published_int_columns;
+
+    /**
+     * Number of rows of every column
+     */
+    std::size_t m_row_count = 0;
+
+public:
+    /**
+     * Declare a field, its values start at 0.
+     * @param p_name Field name
+     * @param p_type Field type
+     * @return field ID, s_no_field if the name is already used with another type
+     */
+    std::uint32_t add_field(const std::string& p_name, const FieldType p_type) {
+        if (const auto& l_field = m_field_ids.find(p_name); l_field != m_field_ids.end()) {
+            return m_fields[l_field->second].m_type == p_type ? l_field->second : s_no_field;
+        }
+        Field l_field;
+        l_field.m_type = p_type;
+        if (p_type == FieldType::Float) {
+            l_field.m_column = static_cast<std::uint32_t>(m_float_columns.size());
+            m_float_columns.emplace_back(m_row_count, 0.0f);
+            m_published_float_columns.emplace_back(m_row_count, 0.0f);
+        } else {
+            l_field.m_column = static_cast<std::uint32_t>(m_int_columns.size());
+            m_int_columns.emplace_back(m_row_count, 0);
+            m_published_int_columns.emplace_back(m_row_count, 0);
+        }
+        const auto l_id = static_cast<std::uint32_t>(m_fields.size());
+        m_field_ids.emplace(p_name, l_id);
+        m_field_names.push_back(p_name);
+        m_fields.push_back(l_field);
+        return l_id;
+    }
+
+    /**
+     * Find a field.
+     * @param p_name Field name
+     * @return field ID, s_no_field if not declared
+     */
+    [[nodiscard]] std::uint32_t find_field(const std::string& p_name) const {
+        const auto& l_field = m_field_ids.find(p_name);
+        return l_field == m_field_ids.end() ? s_no_field : l_field->second;
+    }
+
+    /**
+     * Number of fields.
+     * @return number of fields
+     */
+    [[nodiscard]] std::size_t field_count() const {
+        return m_fields.size();
+    }
+
+    /**
+     * Field name and type.
+     * @param p_field Field ID
+     */
+    [[nodiscard]] const std::string& field_name(const std::uint32_t p_field) const {
+        return m_field_names[p_field];
+    }
+
+    [[nodiscard]] FieldType field_type(const std::uint32_t p_field) const {
+        return m_fields[p_field].m_type;
+    }
+
+    /**
+     * Reset a row to 0 (new agent in the slot), columns grow if needed.
+     * Must not be called while agents run.
+     * @param p_row Row (slot index)
+     */
+    void reset_row(const std::uint32_t p_row) {
+        if (p_row >= m_row_count) {
+            m_row_count = p_row + 1;
+            for (std::size_t l_column = 0; l_column < m_float_columns.size(); ++l_column) {
+                m_float_columns[l_column].resize(m_row_count, 0.0f);
+                m_published_float_columns[l_column].resize(m_row_count, 0.0f);
+            }
+            for (std::size_t l_column = 0; l_column < m_int_columns.size(); ++l_column) {
+                m_int_columns[l_column].resize(m_row_count, 0);
+                m_published_int_columns[l_column].resize(m_row_count, 0);
+            }
+            return;
+        }
+        for (std::size_t l_column = 0; l_column < m_float_columns.size(); ++l_column) {
+            m_float_columns[l_column][p_row] = 0.0f;
+            m_published_float_columns[l_column][p_row] = 0.0f;
+        }
+        for (std::size_t l_column = 0; l_column < m_int_columns.size(); ++l_column) {
+            m_int_columns[l_column][p_row] = 0;
+            m_published_int_columns[l_column][p_row] = 0;
+        }
+    }
+
+    /**
+     * Copy the back columns to the front columns (turn start).
+     */
+    void publish() {
+        for (std::size_t l_column = 0; l_column < m_float_columns.size(); ++l_column) {
+            m_published_float_columns[l_column] = m_float_columns[l_column];
+        }
+        for (std::size_t l_column = 0; l_column < m_int_columns.size(); ++l_column) {
+            m_published_int_columns[l_column] = m_int_columns[l_column];
+        }
+    }
+
+    /**
+     * Current values (back columns).
+     * @param p_field Field ID
+     * @param p_row Row (slot index)
+     */
+    [[nodiscard]] float get_float(const std::uint32_t p_field, const std::uint32_t p_row) const {
+        return m_float_columns[m_fields[p_field].m_column][p_row];
+    }
+    [[nodiscard]] std::int32_t get_int(const std::uint32_t p_field, const std::uint32_t p_row) const {
+        return m_int_columns[m_fields[p_field].m_column][p_row];
+    }
+    void set_float(const std::uint32_t p_field, const std::uint32_t p_row, const float p_value) {
+        m_float_columns[m_fields[p_field].m_column][p_row] = p_value;
+    }
+    void set_int(const std::uint32_t p_field, const std::uint32_t p_row, const std::int32_t p_value) {
+        m_int_columns[m_fields[p_field].m_column][p_row] = p_value;
+    }
+
+    /**
+     * Published values (front columns).
+     * @param p_field Field ID
+     * @param p_row Row (slot index)
+     */
+    [[nodiscard]] float get_published_float(const std::uint32_t p_field, const std::uint32_t p_row) const {
+        return m_published_float_columns[m_fields[p_field].m_column][p_row];
+    }
+    [[nodiscard]] std::int32_t get_published_int(const std::uint32_t p_field, const std::uint32_t p_row) const {
+        return m_published_int_columns[m_fields[p_field].m_column][p_row];
+    }
+};
@@ -0,0 +1,319 @@
+/**************************************************************************
+ *                                                                        *
+ *  Description: MinimalAgent multi-agent framework                       *
+ *  Website:     https://github.com/jferdelyi/MinimalAgent                *
+ *  Copyright:   (c) 2023-Today, Jean-François Erdelyi                    *
+ *                                                                        *
+ *  CPP version of ActressMAS by Florin Leon                              *
+ *  https://github.com/florinleon/ActressMas                              *
+ *                                                                        *
+ *  This program is free software; you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General License as published by         *
+ *  the Free Software Foundation. This program is distributed in the      *
+ *  hope that it will be useful, but WITHOUT ANY WARRANTY; without even   *
+ *  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR   *
+ *  PURPOSE. See the GNU General License for more details.                *
+ *                                                                        *
+ **************************************************************************/
+
+#include "PerceptionFilter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+//###############################################################
+//	Parser
+//###############################################################
+
+class PerceptionFilter::Parser final {
+    const std::string& m_expression;
+    const ConstantResolver& m_constants;
+    PerceptionFilter& m_filter;
+    std::string& m_error;
+    std::size_t m_position = 0;
+    std::size_t m_depth = 0;
+
+public:
+    Parser(const std::string& p_expression, const ConstantResolver& p_constants, PerceptionFilter& p_filter, std::string& p_error) :
+            m_expression(p_expression),
+            m_constants(p_constants),
+            m_filter(p_filter),
+            m_error(p_error) {
+    }
+
+    bool parse() {
+        if (!parse_or()) {
+            return false;
+        }
+        skip_spaces();
+        if (m_position != m_expression.size()) {
+            return fail("unexpected '" + m_expression.substr(m_position, 1) + "'");
+        }
+        return true;
+    }
+
+private:
+    bool fail(const std::string& p_message) {
+        if (m_error.empty()) {
+            m_error = p_message + " at " + std::to_string(m_position);
+        }
+        return false;
+    }
+
+    void skip_spaces() {
+        while (m_position < m_expression.size() && std::isspace(static_cast<unsigned char>(m_expression[m_position]))) {
+            ++m_position;
+        }
+    }
+
+    /**
+     * Consume a symbol (e.g. "<=") or a keyword (e.g. "and", not followed by a name character).
+     */
+    bool accept(const std::string& p_token) {
+        skip_spaces();
+        if (m_expression.compare(m_position, p_token.size(), p_token) != 0) {
+            return false;
+        }
+        const std::size_t l_end = m_position + p_token.size();
+        if (std::isalpha(static_cast<unsigned char>(p_token[0])) && l_end < m_expression.size() && is_name_character(m_expression[l_end])) {
+            return false;
+        }
+        m_position = l_end;
+        return true;
+    }
+
+    static bool is_name_character(const char p_character) {
+        return std::isalnum(static_cast<unsigned char>(p_character)) || p_character == '_';
+    }
+
+    void emit(const OpCode p_op_code, const double p_value = 0.0, const std::uint32_t p_observable = 0) {
+        m_filter.m_program.push_back({p_op_code, p_observable, p_value});
+        if (p_op_code == OpCode::Constant || p_op_code == OpCode::Observable || p_op_code == OpCode::Distance) {
+            ++m_depth;
+            m_filter.m_stack_size = std::max(m_filter.m_stack_size, m_depth);
+        } else if (p_op_code != OpCode::Negate && p_op_code != OpCode::Not) {
+            --m_depth;
+        }
+    }
+
+    bool parse_or() {
+        if (!parse_and()) {
+            return false;
+        }
+        while (accept("or") || accept("||")) {
+            if (!parse_and()) {
+                return false;
+            }
+            emit(OpCode::Or);
+        }
+        return true;
+    }
+
+    bool parse_and() {
+        if (!parse_not()) {
+            return false;
+        }
+        while (accept("and") || accept("&&")) {
+            if (!parse_not()) {
+                return false;
+            }
+            emit(OpCode::And);
+        }
+        return true;
+    }
+
+    bool parse_not() {
+        if (accept("not") || (!lookahead("!=") && accept("!"))) {
+            if (!parse_not()) {
+                return false;
+            }
+            emit(OpCode::Not);
+            return true;
+        }
+        return parse_comparison();
+    }
+
+    bool lookahead(const std::string& p_token) {
+        skip_spaces();
+        return m_expression.compare(m_position, p_token.size(), p_token) == 0;
+    }
+
+    bool parse_comparison() {
+        if (!parse_sum()) {
+            return false;
+        }
+        // Two-character operators first
+        static const std::pair<const char*, OpCode> s_operators[] = {
+                {"==", OpCode::Equal},
+                {"!=", OpCode::NotEqual},
+                {"<=", OpCode::LessEqual},
+                {">=", OpCode::GreaterEqual},
+                {"<", OpCode::Less},
+                {">", OpCode::Greater}
+        };
+        for (const auto& [l_token, l_op_code]: s_operators) {
+            if (accept(l_token)) {
+                if (!parse_sum()) {
+                    return false;
+                }
+                emit(l_op_code);
+                return true;
+            }
+        }
+        return true;
+    }
+
+    bool parse_sum() {
+        if (!parse_product()) {
+            return false;
+        }
+        for (;;) {
+            OpCode l_op_code;
+            if (accept("+")) {
+                l_op_code = OpCode::Add;
+            } else if (accept("-")) {
+                l_op_code = OpCode::Subtract;
+            } else {
+                return true;
+            }
+            if (!parse_product()) {
+                return false;
+            }
+            emit(l_op_code);
+        }
+    }
+
+    bool parse_product() {
+        if (!parse_unary()) {
+            return false;
+        }
+        for (;;) {
+            OpCode l_op_code;
+            if (accept("*")) {
+                l_op_code = OpCode::Multiply;
+            } else if (accept("/")) {
+                l_op_code = OpCode::Divide;
+            } else if (accept("%")) {
+                l_op_code = OpCode::Modulo;
+            } else {
+                return true;
+            }
+            if (!parse_unary()) {
+                return false;
+            }
+            emit(l_op_code);
+        }
+    }
+
+    bool parse_unary() {
+        if (accept("-")) {
+            if (!parse_unary()) {
+                return false;
+            }
+            emit(OpCode::Negate);
+            return true;
+        }
+        if (accept("(")) {
+            if (!parse_or()) {
+                return false;
+            }
+            if (!accept(")")) {
+                return fail("expected ')'");
+            }
+            return true;
+        }
+
+        skip_spaces();
+        if (m_position >= m_expression.size()) {
+            return fail("unexpected end");
+        }
+
+        // Number
+        const char l_first = m_expression[m_position];
+        if (std::isdigit(static_cast<unsigned char>(l_first)) || l_first == '.') {
+            const char* l_begin = m_expression.c_str() + m_position;
+            char* l_end = nullptr;
+            const double l_value = std::strtod(l_begin, &l_end);
+            if (l_end == l_begin) {
+                return fail("invalid number");
+            }
+            m_position += static_cast<std::size_t>(l_end - l_begin);
+            emit(OpCode::Constant, l_value);
+            return true;
+        }
+
+        // Name
+        if (!std::isalpha(static_cast<unsigned char>(l_first)) && l_first != '_') {
+            return fail("unexpected '" + std::string(1, l_first) + "'");
+        }
+        const std::size_t l_begin = m_position;
+        while (m_position < m_expression.size() && is_name_character(m_expression[m_position])) {
+            ++m_position;
+        }
+        const std::string l_name = m_expression.substr(l_begin, m_position - l_begin);
+        if (l_name == "true" || l_name == "false") {
+            emit(OpCode::Constant, l_name == "true" ? 1.0 : 0.0);
+        } else if (l_name == "distance") {
+            m_filter.m_is_using_distance = true;
+            emit(OpCode::Distance);
+        } else if (const std::optional<double> l_constant = m_constants ? m_constants(l_name) : std::nullopt) {
+            emit(OpCode::Constant, l_constant.value());
+        } else {
+            auto l_observable = std::find(m_filter.m_observables.begin(), m_filter.m_observables.end(), l_name);
+            if (l_observable == m_filter.m_observables.end()) {
+                l_observable = m_filter.m_observables.insert(l_observable, l_name);
+            }
+            emit(OpCode::Observable, 0.0, static_cast<std::uint32_t>(l_observable - m_filter.m_observables.begin()));
+        }
+        return true;
+    }
+};
+
+//###############################################################
+//	Filter
+//###############################################################
+
+bool PerceptionFilter::compile(const std::string& p_expression, const ConstantResolver& p_constants, std::string& p_error) {
+    clear();
+    p_error.clear();
+    if (!Parser(p_expression, p_constants, *this, p_error).parse()) {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+double PerceptionFilter::apply(const OpCode p_op_code, const double p_left, const double p_right) {
+    switch (p_op_code) {
+        case OpCode::Add:
+            return p_left + p_right;
+        case OpCode::Subtract:
+            return p_left - p_right;
+        case OpCode::Multiply:
+            return p_left * p_right;
+        case OpCode::Divide:
+            return p_left / p_right;
+        case OpCode::Modulo:
+            return std::fmod(p_left, p_right);
+        case OpCode::Equal:
+            return p_left == p_right ? 1.0 : 0.0;
+        case OpCode::NotEqual:
+            return p_left != p_right ? 1.0 : 0.0;
+        case OpCode::Less:
+            return p_left < p_right ? 1.0 : 0.0;
+        case OpCode::LessEqual:
+            return p_left <= p_right ? 1.0 : 0.0;
+        case OpCode::Greater:
+            return p_left > p_right ? 1.0 : 0.0;
+        case OpCode::GreaterEqual:
+            return p_left >= p_right ? 1.0 : 0.0;
+        case OpCode::And:
+            return p_left != 0.0 && p_right != 0.0 ? 1.0 : 0.0;
+        case OpCode::Or:
+            return p_left != 0.0 || p_right != 0.0 ? 1.0 : 0.0;
+        default:
+            return 0.0;
+    }
+}
@@ -0,0 +1,202 @@
+/**************************************************************************
+ *                                                                        *
+ *  Description: MinimalAgent multi-agent framework                       *
+ *  Website:     https://github.com/jferdelyi/MinimalAgent                *
+ *  Copyright:   (c) 2023-Today, Jean-François Erdelyi                    *
+ *                                                                        *
+ *  CPP version of ActressMAS by Florin Leon                              *
+ *  https://github.com/florinleon/ActressMas                              *
+ *                                                                        *
+ *  This program is free software; you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General License as published by         *
+ *  the Free Software Foundation. This program is distributed in the      *
+ *  hope that it will be useful, but WITHOUT ANY WARRANTY; without even   *
+ *  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR   *
+ *  PURPOSE. See the GNU General License for more details.                *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * Declarative perception filter, compiled once into a small stack program.
+ *
+ * Grammar (numbers only, booleans are 0/1):
+ *   expression := and ("or" | "||") and ...
+ *   and        := not ("and" | "&&") not ...
+ *   not        := ("not" | "!") not | comparison
+ *   comparison := sum [("==" | "!=" | "<" | "<=" | ">" | ">=") sum]
+ *   sum        := product ("+" | "-") product ...
+ *   product    := unary ("*" | "/" | "%") unary ...
+ *   unary      := "-" unary | number | "true" | "false" | "distance" | name | "(" expression ")"
+ *
+ * A name is either a constant given at compile time (e.g. an enum value of the
+ * script) or an observable of the observed agent. "distance" is the distance
+ * between the perceiving and the observed agent (spatial positions).
+ */
+class PerceptionFilter final {
+public:
+    /**
+     * Resolve a constant name.
+     */
+    using ConstantResolver = std::function<std::optional<double>(const std::string&)>;
+
+private:
+    /**
+     * Instructions
+     */
+    enum class OpCode : std::uint8_t {
+        Constant,
+        Observable,
+        Distance,
+        Negate,
+        Not,
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Modulo,
+        Equal,
+        NotEqual,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+        And,
+        Or
+    };
+
+    struct Instruction {
+        OpCode m_op_code = OpCode::Constant;
+        std::uint32_t m_observable = 0;
+        double m_value = 0.0;
+    };
+
+    /**
+     * Program in postfix order
+     */
+    std::vector<Instruction> m_program;
+
+    /**
+     * Observables used by the program (index of Instruction::m_observable)
+     */
+    std::vector<std::string> m_observables;
+
+    /**
+     * Deepest stack used by the program
+     */
+    std::size_t m_stack_size = 0;
+
+    /**
+     * True if the program uses "distance"
+     */
+    bool m_is_using_distance = false;
+
+public:
+    /**
+     * Compile an expression.
+     * @param p_expression Expression
+     * @param p_constants Constant resolver (may be empty)
+     * @param p_error Error message if the compilation fails
+     * @return false if the expression is not valid
+     */
+    bool compile(const std::string& p_expression, const ConstantResolver& p_constants, std::string& p_error);
+
+    /**
+     * True if a program is compiled.
+     * @return true if compiled
+     */
+    [[nodiscard]] bool is_valid() const {
+        return !m_program.empty();
+    }
+
+    /**
+     * Remove the program.
+     */
+    void clear() {
+        m_program.clear();
+        m_observables.clear();
+        m_stack_size = 0;
+        m_is_using_distance = false;
+    }
+
+    /**
+     * Observables used by the program.
+     * @return observable names
+     */
+    [[nodiscard]] const std::vector<std::string>& get_observables() const {
+        return m_observables;
+    }
+
+    [[nodiscard]] bool is_using_distance() const {
+        return m_is_using_distance;
+    }
+
+    /**
+     * Evaluate the program.
+     * @param p_observable Observable loader: bool(observable index, double& value), false if missing
+     * @param p_distance Distance loader: double()
+     * @return true if the observed agent passes the filter (false if an observable is missing)
+     */
+    template<typename O, typename D>
+    [[nodiscard]] bool evaluate(O&& p_observable, D&& p_distance) const {
+        // Filters are tiny, the stack stays on the stack
+        constexpr std::size_t l_small_stack = 32;
+        double l_small[l_small_stack];
+        std::vector<double> l_large;
+        double* l_stack = l_small;
+        if (m_stack_size > l_small_stack) {
+            l_large.resize(m_stack_size);
+            l_stack = l_large.data();
+        }
+
+        std::size_t l_top = 0;
+        for (const Instruction& l_instruction: m_program) {
+            switch (l_instruction.m_op_code) {
+                case OpCode::Constant:
+                    l_stack[l_top++] = l_instruction.m_value;
+                    break;
+                case OpCode::Observable:
+                    if (!p_observable(l_instruction.m_observable, l_stack[l_top++])) {
+                        return false;
+                    }
+                    break;
+                case OpCode::Distance:
+                    l_stack[l_top++] = p_distance();
+                    break;
+                case OpCode::Negate:
+                    l_stack[l_top - 1] = -l_stack[l_top - 1];
+                    break;
+                case OpCode::Not:
+                    l_stack[l_top - 1] = l_stack[l_top - 1] == 0.0 ? 1.0 : 0.0;
+                    break;
+                default:
+                    --l_top;
+                    l_stack[l_top - 1] = apply(l_instruction.m_op_code, l_stack[l_top - 1], l_stack[l_top]);
+                    break;
+            }
+        }
+        return l_top == 1 && l_stack[0] != 0.0;
+    }
+
+private:
+    /**
+     * Apply a binary operator.
+     * @param p_op_code Operator
+     * @param p_left Left operand
+     * @param p_right Right operand
+     * @return result
+     */
+    static double apply(OpCode p_op_code, double p_left, double p_right);
+
+    /**
+     * Recursive descent parser, emits the program.
+     */
+    class Parser;
+};
@@ -0,0 +1,177 @@
+/**************************************************************************
+ *                                                                        *
+ *  Description: MinimalAgent multi-agent framework                       *
+ *  Website:     https://github.com/jferdelyi/MinimalAgent                *
+ *  Copyright:   (c) 2023-Today, Jean-François Erdelyi                    *
+ *                                                                        *
+ *  CPP version of ActressMAS by Florin Leon                              *
+ *  https://github.com/florinleon/ActressMas                              *
+ *                                                                        *
+ *  This program is free software; you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General License as published by         *
+ *  the Free Software Foundation. This program is distributed in the      *
+ *  hope that it will be useful, but WITHOUT ANY WARRANTY; without even   *
+ *  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR   *
+ *  PURPOSE. See the GNU General License for more details.                *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+/**
+ * Counter-based random stream (Philox4x32-10, Salmon et al., SC'11).
+ *
+ * The output only depends on the key (seed, stream) and on the counter (turn,
+ * block), so a stream can be rebuilt anywhere: an agent gets the same numbers
+ * whichever worker runs it, and streams never share any state.
+ */
+class RandomStream final {
+    /**
+     * Philox constants
+     */
+    static constexpr std::uint32_t s_multiplier_0 = 0xD2511F53;
+    static constexpr std::uint32_t s_multiplier_1 = 0xCD9E8D57;
+    static constexpr std::uint32_t s_weyl_0 = 0x9E3779B9;
+    static constexpr std::uint32_t s_weyl_1 = 0xBB67AE85;
+    static constexpr int s_rounds = 10;
+
+    /**
+     * Key: seed, stream
+     */
+    std::array<std::uint32_t, 2> m_key{};
+
+    /**
+     * Counter: block (64 bits), turn, unused
+     */
+    std::array<std::uint32_t, 4> m_counter{};
+
+    /**
+     * Last generated block and the next word to use in it
+     */
+    std::array<std::uint32_t, 4> m_block{};
+    std::size_t m_position = 4;
+
+public:
+    /**
+     * Random stream.
+     * @param p_seed Seed
+     * @param p_stream Stream ID
+     * @param p_turn Turn
+     */
+    explicit RandomStream(const std::uint32_t p_seed = 0, const std::uint32_t p_stream = 0, const std::uint32_t p_turn = 0) {
+        reset(p_seed, p_stream, p_turn);
+    }
+
+    /**
+     * Restart the stream.
+     * @param p_seed Seed
+     * @param p_stream Stream ID
+     * @param p_turn Turn
+     */
+    void reset(const std::uint32_t p_seed, const std::uint32_t p_stream, const std::uint32_t p_turn) {
+        m_key = {p_seed, p_stream};
+        m_counter = {0, 0, p_turn, 0};
+        m_position = 4;
+    }
+
+    /**
+     * Next 32 bits.
+     * @return random value between 0 and 4294967295
+     */
+    std::uint32_t next_u32() {
+        if (m_position == 4) {
+            m_block = philox(m_counter, m_key);
+            m_position = 0;
+            if (++m_counter[0] == 0) {
+                ++m_counter[1];
+            }
+        }
+        return m_block[m_position++];
+    }
+
+    /**
+     * Next 64 bits.
+     * @return random value
+     */
+    std::uint64_t next_u64() {
+        const std::uint64_t l_high = next_u32();
+        return (l_high << 32) | next_u32();
+    }
+
+    /**
+     * Next double.
+     * @return random value in [0.0, 1.0)
+     */
+    double next_double() {
+        return static_cast<double>(next_u64() >> 11) * 0x1.0p-53;
+    }
+
+    /**
+     * Uniform integer (Lemire's multiply and reject, no modulo bias).
+     * @param p_min min value
+     * @param p_max max value (included)
+     * @return random value between min and max
+     */
+    std::int64_t range_int(const std::int64_t p_min, const std::int64_t p_max) {
+        if (p_max <= p_min) {
+            return p_min;
+        }
+        const std::uint64_t l_span = static_cast<std::uint64_t>(p_max - p_min) + 1;
+        if (l_span == 0) {
+            return static_cast<std::int64_t>(next_u64());
+        }
+        if (l_span > UINT32_MAX) {
+            // Rare, keep it simple
+            const std::uint64_t l_limit = UINT64_MAX - UINT64_MAX % l_span;
+            std::uint64_t l_value;
+            do {
+                l_value = next_u64();
+            } while (l_value >= l_limit);
+            return p_min + static_cast<std::int64_t>(l_value % l_span);
+        }
+        std::uint64_t l_product = static_cast<std::uint64_t>(next_u32()) * l_span;
+        if (static_cast<std::uint32_t>(l_product) < l_span) {
+            const auto l_threshold = static_cast<std::uint32_t>(-static_cast<std::uint32_t>(l_span)) % static_cast<std::uint32_t>(l_span);
+            while (static_cast<std::uint32_t>(l_product) < l_threshold) {
+                l_product = static_cast<std::uint64_t>(next_u32()) * l_span;
+            }
+        }
+        return p_min + static_cast<std::int64_t>(l_product >> 32);
+    }
+
+    /**
+     * Uniform double.
+     * @param p_min min value
+     * @param p_max max value
+     * @return random value between min and max
+     */
+    double range_double(const double p_min, const double p_max) {
+        return p_min + (p_max - p_min) * next_double();
+    }
+
+private:
+    /**
+     * Philox4x32-10 block function.
+     * @param p_counter Counter
+     * @param p_key Key
+     * @return 128 random bits
+     */
+    static std::array<std::uint32_t, 4> philox(std::array<std::uint32_t, 4> p_counter, std::array<std::uint32_t, 2> p_key) {
+        for (int l_round = 0; l_round < s_rounds; ++l_round) {
+            const std::uint64_t l_product_0 = static_cast<std::uint64_t>(s_multiplier_0) * p_counter[0];
+            const std::uint64_t l_product_1 = static_cast<std::uint64_t>(s_multiplier_1) * p_counter[2];
+            p_counter = {
+                static_cast<std::uint32_t>(l_product_1 >> 32) ^ p_counter[1] ^ p_key[0],
+                static_cast<std::uint32_t>(l_product_1),
+                static_cast<std::uint32_t>(l_product_0 >> 32) ^ p_counter[3] ^ p_key[1],
+                static_cast<std::uint32_t>(l_product_0)
+            };
+            p_key[0] += s_weyl_0;
+            p_key[1] += s_weyl_1;
+        }
+        return p_counter;
+    }
+};
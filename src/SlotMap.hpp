@@ -0,0 +1,163 @@
+/**************************************************************************
+ *                                                                        *
+ *  Description: MinimalAgent multi-agent framework                       *
+ *  Website:     https://github.com/jferdelyi/MinimalAgent                *
+ *  Copyright:   (c) 2023-Today, Jean-François Erdelyi                    *
+ *                                                                        *
+ *  CPP version of ActressMAS by Florin Leon                              *
+ *  https://github.com/florinleon/ActressMas                              *
+ *                                                                        *
+ *  This program is free software; you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General License as published by         *
+ *  the Free Software Foundation. This program is distributed in the      *
+ *  hope that it will be useful, but WITHOUT ANY WARRANTY; without even   *
+ *  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR   *
+ *  PURPOSE. See the GNU General License for more details.                *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Slot handle: generation (high 32 bits), slot index (low 32 bits). 0 is never valid.
+ */
+using SlotHandle = std::uint64_t;
+
+/**
+ * Slot map: O(1) insert, erase and lookup with generation-checked handles, so a
+ * handle to an erased value is detected even if its slot has been reused.
+ */
+template<typename T>
+class SlotMap {
+    /**
+     * Slot: value, generation, next free slot
+     */
+    struct Slot {
+        T m_value{};
+        std::uint32_t m_generation = 1;
+        std::uint32_t m_next_free = s_no_free_slot;
+        bool m_is_used = false;
+    };
+
+    static constexpr std::uint32_t s_no_free_slot = UINT32_MAX;
+
+    /**
+     * All slots
+     */
+    std::vector<Slot> m_slots;
+
+    /**
+     * Head of the free slot list
+     */
+    std::uint32_t m_free_head = s_no_free_slot;
+
+    /**
+     * Number of used slots
+     */
+    std::size_t m_size = 0;
+
+public:
+    static constexpr SlotHandle s_invalid_handle = 0;
+
+    /**
+     * Slot index of a handle.
+     * @param p_handle handle
+     * @return slot index
+     */
+    static std::uint32_t index_of(const SlotHandle p_handle) {
+        return static_cast<std::uint32_t>(p_handle);
+    }
+
+    /**
+     * Generation of a handle.
+     * @param p_handle handle
+     * @return generation
+     */
+    static std::uint32_t generation_of(const SlotHandle p_handle) {
+        return static_cast<std::uint32_t>(p_handle >> 32);
+    }
+
+    /**
+     * Insert a value.
+     * @param p_value value
+     * @return handle
+     */
+    SlotHandle insert(const T& p_value) {
+        std::uint32_t l_index;
+        if (m_free_head != s_no_free_slot) {
+            l_index = m_free_head;
+            m_free_head = m_slots[l_index].m_next_free;
+        } else {
+            l_index = static_cast<std::uint32_t>(m_slots.size());
+            m_slots.emplace_back();
+        }
+        Slot& l_slot = m_slots[l_index];
+        l_slot.m_value = p_value;
+        l_slot.m_is_used = true;
+        ++m_size;
+        return (static_cast<SlotHandle>(l_slot.m_generation) << 32) | l_index;
+    }
+
+    /**
+     * Erase a value, the handle (and all its copies) becomes invalid.
+     * @param p_handle handle
+     * @return false if the handle was not valid
+     */
+    bool erase(const SlotHandle p_handle) {
+        if (!contains(p_handle)) {
+            return false;
+        }
+        const std::uint32_t l_index = index_of(p_handle);
+        Slot& l_slot = m_slots[l_index];
+        l_slot.m_value = T{};
+        l_slot.m_is_used = false;
+        if (++l_slot.m_generation == 0) {
+            l_slot.m_generation = 1;
+        }
+        l_slot.m_next_free = m_free_head;
+        m_free_head = l_index;
+        --m_size;
+        return true;
+    }
+
+    /**
+     * True if the handle is valid.
+     * @param p_handle handle
+     * @return true if the handle is valid
+     */
+    [[nodiscard]] bool contains(const SlotHandle p_handle) const {
+        const std::uint32_t l_index = index_of(p_handle);
+        return l_index < m_slots.size() && m_slots[l_index].m_is_used && m_slots[l_index].m_generation == generation_of(p_handle);
+    }
+
+    /**
+     * Get a value.
+     * @param p_handle handle
+     * @return pointer to the value, nullptr if the handle is not valid
+     */
+    [[nodiscard]] T* get(const SlotHandle p_handle) {
+        return contains(p_handle) ? &m_slots[index_of(p_handle)].m_value : nullptr;
+    }
+    [[nodiscard]] const T* get(const SlotHandle p_handle) const {
+        return contains(p_handle) ? &m_slots[index_of(p_handle)].m_value : nullptr;
+    }
+
+    /**
+     * Number of values.
+     * @return number of values
+     */
+    [[nodiscard]] std::size_t size() const {
+        return m_size;
+    }
+
+    /**
+     * Number of slots (upper bound of the slot indices).
+     * @return number of slots
+     */
+    [[nodiscard]] std::size_t capacity() const {
+        return m_slots.size();
+    }
+};
@@ -0,0 +1,345 @@
+/**************************************************************************
+ *                                                                        *
+ *  Description: MinimalAgent multi-agent framework                       *
+ *  Website:     https://github.com/jferdelyi/MinimalAgent                *
+ *  Copyright:   (c) 2023-Today, Jean-François Erdelyi                    *
+ *                                                                        *
+ *  CPP version of ActressMAS by Florin Leon                              *
+ *  https://github.com/florinleon/ActressMas                              *
+ *                                                                        *
+ *  This program is free software; you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General License as published by         *
+ *  the Free Software Foundation. This program is distributed in the      *
+ *  hope that it will be useful, but WITHOUT ANY WARRANTY; without even   *
+ *  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR   *
+ *  PURPOSE. See the GNU General License for more details.                *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "SlotMap.hpp"
+
+/**
+ * Spatial hash: uniform grid of square cells, only the occupied cells are stored.
+ *
+ * Items are slot map handles with a 2D position. Insert, move and erase are O(1)
+ * (a move that stays in its cell only updates the position), a query only visits
+ * the cells overlapping the queried area. Emptied cells are kept for reuse, so
+ * once warm, moves do not allocate.
+ */
+class SpatialHash final {
+    /**
+     * Item: handle, position, cell and position in the cell
+     */
+    struct Item {
+        SlotHandle m_handle = 0;
+        float m_x = 0.0f;
+        float m_y = 0.0f;
+        std::uint64_t m_cell = 0;
+        std::uint32_t m_cell_position = 0;
+    };
+
+    static constexpr float s_max_coordinate = 1 << 30;
+
+    /**
+     * Items by slot index (handle 0: no item)
+     */
+    std::vector<Item> m_items;
+
+    /**
+     * Occupied cells: cell key, handles
+     */
+    using Cells = std::unordered_map<std::uint64_t, std::vector<SlotHandle>>;
+    Cells m_cells;
+
+    /**
+     * Emptied cells (map node and handle capacity), reused by the next new cell
+     */
+    std::vector<Cells::node_type> m_free_cells;
+
+    /**
+     * Cell size and its inverse
+     */
+    float m_cell_size;
+    float m_inverse_cell_size;
+
+    /**
+     * Number of items
+     */
+    std::size_t m_size = 0;
+
+public:
+    /**
+     * Spatial hash.
+     * @param p_cell_size Cell size (should be close to the usual query radius)
+     */
+    explicit SpatialHash(const float p_cell_size = 32.0f) :
+            m_cell_size(p_cell_size > 0.0f ? p_cell_size : 1.0f),
+            m_inverse_cell_size(1.0f / m_cell_size) {
+    }
+
+    /**
+     * Change the cell size, all items are rehashed.
+     * @param p_cell_size Cell size
+     */
+    void set_cell_size(const float p_cell_size) {
+        m_cell_size = p_cell_size > 0.0f ? p_cell_size : 1.0f;
+        m_inverse_cell_size = 1.0f / m_cell_size;
+        m_cells.clear();
+        for (Item& l_item: m_items) {
+            if (l_item.m_handle != 0) {
+                l_item.m_cell = cell_of(l_item.m_x, l_item.m_y);
+                add_to_cell(l_item);
+            }
+        }
+    }
+    [[nodiscard]] float get_cell_size() const {
+        return m_cell_size;
+    }
+
+    /**
+     * Insert an item or move it if it is already there.
+     * @param p_handle Handle
+     * @param p_x X position
+     * @param p_y Y position
+     */
+    void move(const SlotHandle p_handle, const float p_x, const float p_y) {
+        const std::uint32_t l_index = SlotMap<int>::index_of(p_handle);
+        if (l_index >= m_items.size()) {
+            m_items.resize(l_index + 1);
+        }
+        Item& l_item = m_items[l_index];
+        const std::uint64_t l_cell = cell_of(p_x, p_y);
+        if (l_item.m_handle != p_handle) {
+            if (l_item.m_handle != 0) {
+                // Stale handle of the same slot
+                remove_from_cell(l_item);
+                --m_size;
+            }
+            l_item.m_handle = p_handle;
+            l_item.m_cell = l_cell;
+            add_to_cell(l_item);
+            ++m_size;
+        } else if (l_item.m_cell != l_cell) {
+            remove_from_cell(l_item);
+            l_item.m_cell = l_cell;
+            add_to_cell(l_item);
+        }
+        l_item.m_x = p_x;
+        l_item.m_y = p_y;
+    }
+
+    /**
+     * Erase an item.
+     * @param p_handle Handle
+     * @return false if the item was not there
+     */
+    bool erase(const SlotHandle p_handle) {
+        if (!contains(p_handle)) {
+            return false;
+        }
+        Item& l_item = m_items[SlotMap<int>::index_of(p_handle)];
+        remove_from_cell(l_item);
+        l_item = Item();
+        --m_size;
+        return true;
+    }
+
+    /**
+     * True if the item is there.
+     * @param p_handle Handle
+     * @return true if the item is there
+     */
+    [[nodiscard]] bool contains(const SlotHandle p_handle) const {
+        const std::uint32_t l_index = SlotMap<int>::index_of(p_handle);
+        return p_handle != 0 && l_index < m_items.size() && m_items[l_index].m_handle == p_handle;
+    }
+
+    /**
+     * Position of an item.
+     * @param p_handle Handle
+     * @param p_x X position (unchanged if the item is not there)
+     * @param p_y Y position (unchanged if the item is not there)
+     * @return false if the item is not there
+     */
+    bool get_position(const SlotHandle p_handle, float& p_x, float& p_y) const {
+        if (!contains(p_handle)) {
+            return false;
+        }
+        const Item& l_item = m_items[SlotMap<int>::index_of(p_handle)];
+        p_x = l_item.m_x;
+        p_y = l_item.m_y;
+        return true;
+    }
+
+    /**
+     * Number of items.
+     * @return number of items
+     */
+    [[nodiscard]] std::size_t size() const {
+        return m_size;
+    }
+
+    /**
+     * Remove all items.
+     */
+    void clear() {
+        m_items.clear();
+        m_cells.clear();
+        m_size = 0;
+    }
+
+    /**
+     * Call p_function(handle, x, y) on each item in the rectangle (bounds included).
+     * @param p_min_x Min X
+     * @param p_min_y Min Y
+     * @param p_max_x Max X
+     * @param p_max_y Max Y
+     * @param p_function Function
+     */
+    template<typename F>
+    void query_rect(const float p_min_x, const float p_min_y, const float p_max_x, const float p_max_y, F&& p_function) const {
+        for_each_candidate(p_min_x, p_min_y, p_max_x, p_max_y, [&](const Item& p_item) {
+            if (p_item.m_x >= p_min_x && p_item.m_x <= p_max_x && p_item.m_y >= p_min_y && p_item.m_y <= p_max_y) {
+                p_function(p_item.m_handle, p_item.m_x, p_item.m_y);
+            }
+        });
+    }
+
+    /**
+     * Call p_function(handle, x, y) on each item in the disc (border included).
+     * @param p_x Center X
+     * @param p_y Center Y
+     * @param p_radius Radius
+     * @param p_function Function
+     */
+    template<typename F>
+    void query_radius(const float p_x, const float p_y, const float p_radius, F&& p_function) const {
+        const float l_squared_radius = p_radius * p_radius;
+        for_each_candidate(p_x - p_radius, p_y - p_radius, p_x + p_radius, p_y + p_radius, [&](const Item& p_item) {
+            const float l_dx = p_item.m_x - p_x;
+            const float l_dy = p_item.m_y - p_y;
+            if (l_dx * l_dx + l_dy * l_dy <= l_squared_radius) {
+                p_function(p_item.m_handle, p_item.m_x, p_item.m_y);
+            }
+        });
+    }
+
+private:
+    /**
+     * Cell coordinate of a position.
+     * @param p_value Position
+     * @return cell coordinate
+     */
+    [[nodiscard]] std::int32_t coordinate_of(const float p_value) const {
+        // Clamped so that huge query bounds stay representable
+        const float l_coordinate = std::floor(p_value * m_inverse_cell_size);
+        return static_cast<std::int32_t>(std::clamp(l_coordinate, -s_max_coordinate, s_max_coordinate));
+    }
+
+    /**
+     * Key of a cell.
+     * @param p_cell_x Cell X
+     * @param p_cell_y Cell Y
+     * @return cell key
+     */
+    static std::uint64_t key_of(const std::int32_t p_cell_x, const std::int32_t p_cell_y) {
+        return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(p_cell_x)) << 32) | static_cast<std::uint32_t>(p_cell_y);
+    }
+
+    /**
+     * Key of the cell containing a position.
+     * @param p_x X position
+     * @param p_y Y position
+     * @return cell key
+     */
+    [[nodiscard]] std::uint64_t cell_of(const float p_x, const float p_y) const {
+        return key_of(coordinate_of(p_x), coordinate_of(p_y));
+    }
+
+    /**
+     * Append an item to its cell.
+     * @param p_item Item
+     */
+    void add_to_cell(Item& p_item) {
+        auto l_cell = m_cells.find(p_item.m_cell);
+        if (l_cell == m_cells.end()) {
+            if (m_free_cells.empty()) {
+                l_cell = m_cells.try_emplace(p_item.m_cell).first;
+            } else {
+                Cells::node_type l_node = std::move(m_free_cells.back());
+                m_free_cells.pop_back();
+                l_node.key() = p_item.m_cell;
+                l_cell = m_cells.insert(std::move(l_node)).position;
+            }
+        }
+        p_item.m_cell_position = static_cast<std::uint32_t>(l_cell->second.size());
+        l_cell->second.push_back(p_item.m_handle);
+    }
+
+    /**
+     * Remove an item from its cell (swap and pop).
+     * @param p_item Item
+     */
+    void remove_from_cell(const Item& p_item) {
+        const auto l_cell = m_cells.find(p_item.m_cell);
+        std::vector<SlotHandle>& l_handles = l_cell->second;
+        const SlotHandle l_moved = l_handles.back();
+        l_handles[p_item.m_cell_position] = l_moved;
+        m_items[SlotMap<int>::index_of(l_moved)].m_cell_position = p_item.m_cell_position;
+        l_handles.pop_back();
+        if (l_handles.empty()) {
+            m_free_cells.push_back(m_cells.extract(l_cell));
+        }
+    }
+
+    /**
+     * Call p_function(item) on each item of the cells overlapping the rectangle.
+     * Wide rectangles scan the occupied cells instead of the covered ones.
+     */
+    template<typename F>
+    void for_each_candidate(const float p_min_x, const float p_min_y, const float p_max_x, const float p_max_y, F&& p_function) const {
+        if (p_max_x < p_min_x || p_max_y < p_min_y) {
+            return;
+        }
+        const std::int64_t l_min_x = coordinate_of(p_min_x);
+        const std::int64_t l_min_y = coordinate_of(p_min_y);
+        const std::int64_t l_max_x = coordinate_of(p_max_x);
+        const std::int64_t l_max_y = coordinate_of(p_max_y);
+        const std::uint64_t l_covered = static_cast<std::uint64_t>(l_max_x - l_min_x + 1) * static_cast<std::uint64_t>(l_max_y - l_min_y + 1);
+
+        if (l_covered > m_cells.size()) {
+            for (const auto& [l_key, l_handles]: m_cells) {
+                const auto l_cell_x = static_cast<std::int32_t>(l_key >> 32);
+                const auto l_cell_y = static_cast<std::int32_t>(static_cast<std::uint32_t>(l_key));
+                if (l_cell_x < l_min_x || l_cell_x > l_max_x || l_cell_y < l_min_y || l_cell_y > l_max_y) {
+                    continue;
+                }
+                for (const SlotHandle l_handle: l_handles) {
+                    p_function(m_items[SlotMap<int>::index_of(l_handle)]);
+                }
+            }
+            return;
+        }
+
+        for (std::int64_t l_cell_x = l_min_x; l_cell_x <= l_max_x; ++l_cell_x) {
+            for (std::int64_t l_cell_y = l_min_y; l_cell_y <= l_max_y; ++l_cell_y) {
+                const auto l_cell = m_cells.find(key_of(static_cast<std::int32_t>(l_cell_x), static_cast<std::int32_t>(l_cell_y)));
+                if (l_cell == m_cells.end()) {
+                    continue;
+                }
+                for (const SlotHandle l_handle: l_cell->second) {
+                    p_function(m_items[SlotMap<int>::index_of(l_handle)]);
+                }
+            }
+        }
+    }
+};
@@ -0,0 +1,396 @@
+/**************************************************************************
+ *                                                                        *
+ *  Description: MinimalAgent multi-agent framework                       *
+ *  Website:     https://github.com/jferdelyi/MinimalAgent                *
+ *  Copyright:   (c) 2023-Today, Jean-François Erdelyi                    *
+ *                                                                        *
+ *  CPP version of ActressMAS by Florin Leon                              *
+ *  https://github.com/florinleon/ActressMas                              *
+ *                                                                        *
+ *  This program is free software; you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General License as published by         *
+ *  the Free Software Foundation. This program is distributed in the      *
+ *  hope that it will be useful, but WITHOUT ANY WARRANTY; without even   *
+ *  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR   *
+ *  PURPOSE. See the GNU General License for more details.                *
+ *                                                                        *
+ **************************************************************************/
+
+#include "TaskScheduler.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__) || defined(__APPLE__)
+#include <pthread.h>
+#endif
+
+namespace {
+    /**
+     * Wait until p_is_ready(value): poll for p_spin_microseconds, then park on the
+     * atomic until a notify changes it.
+     * @return the ready value
+     */
+    template<typename T, typename P>
+    T spin_then_park(const std::atomic<T>& p_value, P&& p_is_ready, const uint32_t p_spin_microseconds) {
+        T l_value = p_value.load(std::memory_order_acquire);
+        if (p_is_ready(l_value)) {
+            return l_value;
+        }
+        if (p_spin_microseconds > 0) {
+            const auto l_deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(p_spin_microseconds);
+            do {
+                std::this_thread::yield();
+                l_value = p_value.load(std::memory_order_acquire);
+                if (p_is_ready(l_value)) {
+                    return l_value;
+                }
+            } while (std::chrono::steady_clock::now() < l_deadline);
+        }
+        for (;;) {
+            p_value.wait(l_value, std::memory_order_acquire);
+            l_value = p_value.load(std::memory_order_acquire);
+            if (p_is_ready(l_value)) {
+                return l_value;
+            }
+        }
+    }
+}
+
+//###############################################################
+//	Worker threads
+//###############################################################
+
+thread_local size_t TaskScheduler::s_current_worker = 0;
+
+int TaskScheduler::core_of(const uint64_t p_affinity_mask, const size_t p_worker) {
+    if (p_affinity_mask == 0) {
+        return -1;
+    }
+    size_t l_rank = p_worker % static_cast<size_t>(std::popcount(p_affinity_mask));
+    uint64_t l_mask = p_affinity_mask;
+    while (l_rank-- > 0) {
+        l_mask &= l_mask - 1;
+    }
+    return std::countr_zero(l_mask);
+}
+
+void TaskScheduler::setup_current_thread(const std::string& p_name, const int p_core) {
+#if defined(_WIN32)
+    SetThreadDescription(GetCurrentThread(), std::wstring(p_name.begin(), p_name.end()).c_str());
+    if (p_core >= 0) {
+        SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << p_core);
+    }
+#elif defined(__linux__)
+    // Linux thread names are limited to 15 characters
+    pthread_setname_np(pthread_self(), p_name.substr(0, 15).c_str());
+    if (p_core >= 0) {
+        cpu_set_t l_cores;
+        CPU_ZERO(&l_cores);
+        CPU_SET(p_core, &l_cores);
+        pthread_setaffinity_np(pthread_self(), sizeof(l_cores), &l_cores);
+    }
+#elif defined(__APPLE__)
+    // No thread pinning on macOS
+    pthread_setname_np(p_name.c_str());
+    (void) p_core;
+#else
+    (void) p_name;
+    (void) p_core;
+#endif
+}
+
+//###############################################################
+//	Worker deque
+//###############################################################
+
+void TaskScheduler::WorkerDeque::lock() {
+    while (m_lock.test_and_set(std::memory_order_acquire)) {
+        while (m_lock.test(std::memory_order_relaxed)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void TaskScheduler::WorkerDeque::unlock() {
+    m_lock.clear(std::memory_order_release);
+}
+
+bool TaskScheduler::WorkerDeque::push_bottom(const Range& p_range) {
+    lock();
+    if (m_bottom - m_top == s_deque_capacity) {
+        unlock();
+        return false;
+    }
+    m_ranges[m_bottom++ % s_deque_capacity] = p_range;
+    unlock();
+    return true;
+}
+
+bool TaskScheduler::WorkerDeque::pop_bottom(Range& p_range) {
+    lock();
+    if (m_bottom == m_top) {
+        unlock();
+        return false;
+    }
+    p_range = m_ranges[--m_bottom % s_deque_capacity];
+    unlock();
+    return true;
+}
+
+bool TaskScheduler::WorkerDeque::steal_top(Range& p_range) {
+    lock();
+    if (m_bottom == m_top) {
+        unlock();
+        return false;
+    }
+    p_range = m_ranges[m_top++ % s_deque_capacity];
+    unlock();
+    return true;
+}
+
+bool TaskScheduler::WorkerDeque::is_empty() {
+    lock();
+    const bool l_is_empty = m_bottom == m_top;
+    unlock();
+    return l_is_empty;
+}
+
+//###############################################################
+//	Constructor
+//###############################################################
+
+TaskScheduler::TaskScheduler(const size_t p_worker_count) :
+        TaskScheduler(Settings{p_worker_count}) {
+}
+
+TaskScheduler::TaskScheduler(const Settings& p_settings) :
+        m_settings(p_settings),
+        m_spin_microseconds(p_settings.m_spin_microseconds) {
+    start_workers();
+}
+
+TaskScheduler::~TaskScheduler() {
+    stop_workers();
+}
+
+//###############################################################
+//	Settings
+//###############################################################
+
+void TaskScheduler::configure(const Settings& p_settings) {
+    // Taking the job lock here would deadlock when called from a chunk of the running job
+    m_spin_microseconds.store(p_settings.m_spin_microseconds, std::memory_order_relaxed);
+    std::unique_lock l_settings_lock(m_settings_mutex);
+    m_pending_settings = p_settings;
+    m_has_pending_settings.store(true, std::memory_order_release);
+}
+
+TaskScheduler::Settings TaskScheduler::get_settings() {
+    std::unique_lock l_settings_lock(m_settings_mutex);
+    return m_has_pending_settings.load(std::memory_order_relaxed) ? m_pending_settings : m_settings;
+}
+
+void TaskScheduler::apply_pending_settings() {
+    if (!m_has_pending_settings.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::unique_lock l_settings_lock(m_settings_mutex);
+    const Settings l_settings = m_pending_settings;
+    m_has_pending_settings.store(false, std::memory_order_relaxed);
+    Settings l_started = m_settings;
+    l_started.m_spin_microseconds = l_settings.m_spin_microseconds;
+    if (l_started == l_settings) {
+        m_settings = l_settings;
+        return;
+    }
+    l_settings_lock.unlock();
+
+    // Threads are named and pinned when they start
+    stop_workers();
+    l_settings_lock.lock();
+    m_settings = l_settings;
+    l_settings_lock.unlock();
+    start_workers();
+}
+
+void TaskScheduler::start_workers() {
+    size_t l_worker_count = m_settings.m_worker_count;
+    if (l_worker_count == 0) {
+        l_worker_count = std::thread::hardware_concurrency() == 0 ? 8 : std::thread::hardware_concurrency();
+    }
+    m_deques = std::make_unique<WorkerDeque[]>(l_worker_count);
+    m_worker_count.store(l_worker_count, std::memory_order_relaxed);
+
+    const uint64_t l_job = m_job.load(std::memory_order_relaxed);
+    m_threads.reserve(l_worker_count - 1);
+    for (size_t l_index = 1; l_index < l_worker_count; ++l_index) {
+        const std::string l_name = m_settings.m_thread_name_prefix + "-" + std::to_string(l_index);
+        const int l_core = core_of(m_settings.m_affinity_mask, l_index - 1);
+        m_threads.emplace_back([this, l_index, l_job, l_name, l_core] {
+            setup_current_thread(l_name, l_core);
+            s_current_worker = l_index;
+            worker_loop(l_index, l_job);
+        });
+    }
+}
+
+void TaskScheduler::stop_workers() {
+    m_is_stopping.store(true, std::memory_order_relaxed);
+    m_job.fetch_add(uint64_t(1) << s_limit_bits, std::memory_order_release);
+    m_job.notify_all();
+    for (std::thread& l_thread: m_threads) {
+        l_thread.join();
+    }
+    m_threads.clear();
+    m_is_stopping.store(false, std::memory_order_relaxed);
+}
+
+//###############################################################
+//	Scheduling
+//###############################################################
+
+std::shared_ptr<TaskScheduler> TaskScheduler::get_shared(const Settings& p_settings) {
+    static std::mutex s_mutex;
+    static std::weak_ptr<TaskScheduler> s_scheduler;
+    std::unique_lock l_lock(s_mutex);
+    std::shared_ptr<TaskScheduler> l_scheduler = s_scheduler.lock();
+    if (!l_scheduler) {
+        l_scheduler = std::make_shared<TaskScheduler>(p_settings);
+        s_scheduler = l_scheduler;
+    }
+    return l_scheduler;
+}
+
+uint64_t TaskScheduler::parallel_for(const size_t p_count, const size_t p_grain, const RangeFunction& p_function, const size_t p_max_workers, const PrepareFunction& p_prepare) {
+    // Not worth waking anybody
+    const size_t l_grain = std::max<size_t>(p_grain, 1);
+    if (p_count == 0 || p_max_workers == 1 || p_count <= l_grain) {
+        if (p_prepare) {
+            p_prepare(1);
+        }
+        if (p_count > 0) {
+            p_function(0, p_count);
+        }
+        return 0;
+    }
+
+    // The worker count only changes between jobs
+    std::unique_lock l_job_lock(m_job_mutex);
+    apply_pending_settings();
+    const size_t l_worker_count = m_worker_count.load(std::memory_order_relaxed);
+    const size_t l_worker_limit = p_max_workers == 0 ? l_worker_count : std::min(p_max_workers, l_worker_count);
+    const size_t l_workers = std::min(l_worker_limit, (p_count + l_grain - 1) / l_grain);
+    if (p_prepare) {
+        p_prepare(l_workers);
+    }
+    if (l_workers == 1) {
+        l_job_lock.unlock();
+        p_function(0, p_count);
+        return 0;
+    }
+
+    // Publish the job, then the ranges: a late worker of the previous job finds
+    // the deques empty until the job changes, then leaves
+    m_remaining.store(p_count, std::memory_order_relaxed);
+    m_grain.store(l_grain, std::memory_order_relaxed);
+    m_function.store(&p_function, std::memory_order_relaxed);
+    const uint64_t l_job = ((m_job.load(std::memory_order_relaxed) >> s_limit_bits) + 1) << s_limit_bits | l_workers;
+    m_job.store(l_job, std::memory_order_release);
+
+    // One contiguous range per worker
+    const size_t l_step = p_count / l_workers;
+    const size_t l_extra = p_count % l_workers;
+    size_t l_begin = 0;
+    for (size_t l_index = 0; l_index < l_workers; ++l_index) {
+        const size_t l_end = l_begin + l_step + (l_index < l_extra ? 1 : 0);
+        m_deques[l_index].push_bottom({l_begin, l_end});
+        l_begin = l_end;
+    }
+
+    // Spinning workers already saw the job, parked ones need a wake up
+    m_job.notify_all();
+
+    // Work too, then wait for the end of the turn
+    participate(0, l_job);
+    const auto l_start = std::chrono::steady_clock::now();
+    spin_then_park(m_remaining, [](const size_t p_remaining) {
+        return p_remaining == 0;
+    }, m_spin_microseconds.load(std::memory_order_relaxed));
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - l_start).count());
+}
+
+void TaskScheduler::worker_loop(const size_t p_index, const uint64_t p_job) {
+    uint64_t l_job = p_job;
+    for (;;) {
+        // Stay hot for a while, then sleep until the next job
+        l_job = spin_then_park(m_job, [l_job](const uint64_t p_next) {
+            return p_next != l_job;
+        }, m_spin_microseconds.load(std::memory_order_relaxed));
+        if (m_is_stopping.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        // Workers beyond the job limit sit this one out
+        if (p_index < (l_job & ((uint64_t(1) << s_limit_bits) - 1))) {
+            participate(p_index, l_job);
+        }
+    }
+}
+
+void TaskScheduler::participate(const size_t p_index, const uint64_t p_job) {
+    WorkerDeque& l_own = m_deques[p_index];
+    Range l_range;
+    while (m_remaining.load(std::memory_order_acquire) != 0 && m_job.load(std::memory_order_acquire) == p_job) {
+        if (!acquire(p_index, l_range)) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Stolen from the next job: hand it back to the workers of that job
+        if (m_job.load(std::memory_order_acquire) != p_job && l_own.push_bottom(l_range)) {
+            return;
+        }
+
+        const RangeFunction& l_function = *m_function.load(std::memory_order_acquire);
+        const size_t l_grain = m_grain.load(std::memory_order_relaxed);
+        while (l_range.m_begin < l_range.m_end) {
+
+            // Lazy binary splitting: give away half only if nobody can steal from us
+            if (l_range.m_end - l_range.m_begin > 2 * l_grain && l_own.is_empty()) {
+                const size_t l_middle = l_range.m_begin + (l_range.m_end - l_range.m_begin) / 2;
+                if (l_own.push_bottom({l_middle, l_range.m_end})) {
+                    l_range.m_end = l_middle;
+                }
+            }
+
+            const size_t l_end = std::min(l_range.m_begin + l_grain, l_range.m_end);
+            l_function(l_range.m_begin, l_end);
+            const size_t l_done = l_end - l_range.m_begin;
+            l_range.m_begin = l_end;
+
+            // Last chunk of the job
+            if (m_remaining.fetch_sub(l_done, std::memory_order_acq_rel) == l_done) {
+                m_remaining.notify_all();
+            }
+        }
+    }
+}
+
+bool TaskScheduler::acquire(const size_t p_index, Range& p_range) {
+    if (m_deques[p_index].pop_bottom(p_range)) {
+        return true;
+    }
+    const size_t l_worker_count = m_worker_count.load(std::memory_order_relaxed);
+    for (size_t l_offset = 1; l_offset < l_worker_count; ++l_offset) {
+        if (m_deques[(p_index + l_offset) % l_worker_count].steal_top(p_range)) {
+            return true;
+        }
+    }
+    return false;
+}
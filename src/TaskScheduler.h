@@ -0,0 +1,310 @@
+/**************************************************************************
+ *                                                                        *
+ *  Description: MinimalAgent multi-agent framework                       *
+ *  Website:     https://github.com/jferdelyi/MinimalAgent                *
+ *  Copyright:   (c) 2023-Today, Jean-François Erdelyi                    *
+ *                                                                        *
+ *  CPP version of ActressMAS by Florin Leon                              *
+ *  https://github.com/florinleon/ActressMas                              *
+ *                                                                        *
+ *  This program is free software; you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General License as published by         *
+ *  the Free Software Foundation. This program is distributed in the      *
+ *  hope that it will be useful, but WITHOUT ANY WARRANTY; without even   *
+ *  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR   *
+ *  PURPOSE. See the GNU General License for more details.                *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Work-stealing scheduler used to run the agents of one turn in parallel.
+ *
+ * A call to parallel_for splits [0, count) into one range per worker. Each worker
+ * owns a small deque of ranges: it pops from the bottom of its own deque and
+ * steals from the top of the others when it runs dry. Ranges are split lazily
+ * (only while the owner's deque is empty, i.e. when there is someone to feed),
+ * so the number of tasks adapts to the imbalance instead of the agent count.
+ * The calling thread takes part in the work and returns once every index has
+ * been processed (single turn barrier, no per-task future).
+ *
+ * Workers and the barrier spin for a while before parking on the atomic
+ * (futex on Linux), so back-to-back turns do not pay a wake up.
+ *
+ * Environments share one process-wide scheduler (see get_shared), each job may
+ * use fewer workers than the scheduler has.
+ */
+class TaskScheduler final {
+public:
+    /**
+     * Half-open range of indices [m_begin, m_end).
+     */
+    struct Range {
+        size_t m_begin = 0;
+        size_t m_end = 0;
+    };
+
+    /**
+     * Function applied to each chunk: (begin, end).
+     */
+    using RangeFunction = std::function<void(size_t, size_t)>;
+
+    /**
+     * Function called before a job runs: (number of workers of the job).
+     */
+    using PrepareFunction = std::function<void(size_t)>;
+
+    /**
+     * Pool settings.
+     */
+    struct Settings {
+        /**
+         * Number of workers including the calling thread (0 means hardware concurrency)
+         */
+        size_t m_worker_count = 0;
+
+        /**
+         * Cores of the background workers: worker i runs on the i-th set bit, in turn (0 means no pinning)
+         */
+        uint64_t m_affinity_mask = 0;
+
+        /**
+         * Time an idle worker keeps polling for the next job (and the calling thread
+         * for the end of the job) before sleeping, keeps the workers hot between
+         * back-to-back turns
+         */
+        uint32_t m_spin_microseconds = 50;
+
+        /**
+         * Background thread names (prefix + worker index), as shown by profilers
+         */
+        std::string m_thread_name_prefix = "mas-worker";
+
+        bool operator==(const Settings& p_other) const = default;
+    };
+
+private:
+    /**
+     * Maximum number of ranges in a worker deque. Lazy binary splitting never goes
+     * deeper than log2(count), so it is only reached with absurd counts; a full
+     * deque simply stops splitting.
+     */
+    static constexpr size_t s_deque_capacity = 64;
+
+    /**
+     * Per-worker deque of ranges, padded to avoid false sharing.
+     */
+    struct alignas(64) WorkerDeque {
+        std::atomic_flag m_lock = ATOMIC_FLAG_INIT;
+        std::array<Range, s_deque_capacity> m_ranges{};
+        size_t m_top = 0;
+        size_t m_bottom = 0;
+
+        void lock();
+        void unlock();
+        bool push_bottom(const Range& p_range);
+        bool pop_bottom(Range& p_range);
+        bool steal_top(Range& p_range);
+        bool is_empty();
+    };
+
+    /**
+     * Worker deques, index 0 belongs to the thread calling parallel_for.
+     */
+    std::unique_ptr<WorkerDeque[]> m_deques;
+
+    /**
+     * Background threads (worker index 1..n).
+     */
+    std::vector<std::thread> m_threads;
+
+    /**
+     * Settings the workers were started with (written between jobs only, under both locks).
+     */
+    Settings m_settings;
+
+    /**
+     * Settings given to configure, applied before the next job.
+     */
+    Settings m_pending_settings;
+    std::atomic<bool> m_has_pending_settings = false;
+
+    /**
+     * Guard m_pending_settings, and m_settings against get_settings.
+     */
+    std::mutex m_settings_mutex;
+
+    /**
+     * Number of workers including the calling thread.
+     */
+    std::atomic<size_t> m_worker_count = 1;
+
+    /**
+     * Idle polling time before sleeping.
+     */
+    std::atomic<uint32_t> m_spin_microseconds = 0;
+
+    /**
+     * Bits of the worker limit in m_job.
+     */
+    static constexpr uint64_t s_limit_bits = 16;
+
+    /**
+     * Current job. Workers wait for m_job to change: job number << s_limit_bits | worker limit.
+     */
+    std::atomic<const RangeFunction*> m_function = nullptr;
+    std::atomic<size_t> m_grain = 1;
+    std::atomic<size_t> m_remaining = 0;
+    std::atomic<uint64_t> m_job = 0;
+    std::atomic<bool> m_is_stopping = false;
+
+    /**
+     * Worker index of the current thread (0 for any thread that is not a worker).
+     */
+    static thread_local size_t s_current_worker;
+
+    /**
+     * Serialize concurrent parallel_for calls (several environments may share a scheduler).
+     */
+    std::mutex m_job_mutex;
+
+public:
+    /**
+     * Create the scheduler.
+     * @param p_worker_count number of workers including the calling thread (0 means hardware concurrency)
+     */
+    explicit TaskScheduler(size_t p_worker_count = 0);
+
+    /**
+     * Create the scheduler.
+     * @param p_settings pool settings
+     */
+    explicit TaskScheduler(const Settings& p_settings);
+
+    /**
+     * Join all threads.
+     */
+    ~TaskScheduler();
+
+    /**
+     * Process-wide scheduler, created on first use and destroyed with its last
+     * user (no thread outlives the environments).
+     * @param p_settings settings used if the scheduler does not exist yet
+     * @return shared scheduler
+     */
+    static std::shared_ptr<TaskScheduler> get_shared(const Settings& p_settings);
+
+    /**
+     * Apply new settings. The spin time changes at once, other changes are queued
+     * and restart the workers before the next job. Never waits for a running job,
+     * so an agent of that job may call it.
+     * @param p_settings pool settings
+     */
+    void configure(const Settings& p_settings);
+
+    /**
+     * Worker index of the calling thread, stable during a job: 0 for the thread
+     * calling parallel_for, 1..n-1 for the background workers.
+     * @return worker index
+     */
+    [[nodiscard]] static size_t get_current_worker() {
+        return s_current_worker;
+    }
+
+    /**
+     * Current settings (the queued ones if any).
+     * @return settings
+     */
+    [[nodiscard]] Settings get_settings();
+
+    /**
+     * Apply p_function on [0, p_count) in chunks of at most p_grain indices.
+     * Blocks until all indices have been processed.
+     * @param p_count number of indices
+     * @param p_grain maximum chunk size
+     * @param p_function chunk function
+     * @param p_max_workers maximum number of workers used by this job, calling thread included (0 means all)
+     * @param p_prepare called with the number of workers of this job before any chunk
+     * runs: every get_current_worker() of the job is below it
+     * @return time the calling thread waited for the other workers at the end (nanoseconds)
+     */
+    uint64_t parallel_for(size_t p_count, size_t p_grain, const RangeFunction& p_function, size_t p_max_workers = 0, const PrepareFunction& p_prepare = nullptr);
+
+    /**
+     * Number of workers including the calling thread (queued settings apply at the next job).
+     * @return number of workers
+     */
+    [[nodiscard]] size_t get_worker_count() const {
+        return m_worker_count.load(std::memory_order_relaxed);
+    }
+
+    // Delete copy constructor
+    TaskScheduler(const TaskScheduler&) = delete;
+
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+private:
+    /**
+     * Core of a background worker.
+     * @param p_affinity_mask allowed cores
+     * @param p_worker background worker rank (from 0)
+     * @return core index, -1 if not pinned
+     */
+    static int core_of(uint64_t p_affinity_mask, size_t p_worker);
+
+    /**
+     * Name and pin the calling thread (best effort, platform dependent).
+     * @param p_name thread name
+     * @param p_core core index, -1 if not pinned
+     */
+    static void setup_current_thread(const std::string& p_name, int p_core);
+
+    /**
+     * Apply the settings queued by configure (job lock held, no job running).
+     */
+    void apply_pending_settings();
+
+    /**
+     * Start the background workers with m_settings (no job running).
+     */
+    void start_workers();
+
+    /**
+     * Stop and join the background workers (no job running).
+     */
+    void stop_workers();
+
+    /**
+     * Background worker loop.
+     * @param p_index worker index
+     * @param p_job job when the worker was started
+     */
+    void worker_loop(size_t p_index, uint64_t p_job);
+
+    /**
+     * Run ranges of a job until there is nothing left.
+     * @param p_index worker index
+     * @param p_job job joined (a late worker must not spill into the next job)
+     */
+    void participate(size_t p_index, uint64_t p_job);
+
+    /**
+     * Find work: own deque first, then steal.
+     * @param p_index worker index
+     * @param p_range found range
+     * @return false if nothing was found
+     */
+    bool acquire(size_t p_index, Range& p_range);
+};
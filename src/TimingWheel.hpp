@@ -0,0 +1,229 @@
+/**************************************************************************
+ *                                                                        *
+ *  Description: MinimalAgent multi-agent framework                       *
+ *  Website:     https://github.com/jferdelyi/MinimalAgent                *
+ *  Copyright:   (c) 2023-Today, Jean-François Erdelyi                    *
+ *                                                                        *
+ *  CPP version of ActressMAS by Florin Leon                              *
+ *  https://github.com/florinleon/ActressMas                              *
+ *                                                                        *
+ *  This program is free software; you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General License as published by         *
+ *  the Free Software Foundation. This program is distributed in the      *
+ *  hope that it will be useful, but WITHOUT ANY WARRANTY; without even   *
+ *  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR   *
+ *  PURPOSE. See the GNU General License for more details.                *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#include "SlotMap.hpp"
+
+/**
+ * Hierarchical timing wheel keyed by turn: O(1) schedule, cancel and expiry.
+ *
+ * Level L has 64 buckets of 64^L turns. A timer goes to the lowest level whose
+ * span still contains both the current turn and its due turn, and moves down one
+ * or more levels when the wheel reaches its bucket (cascade), so each timer is
+ * touched at most once per level. Timers further than 64^4 turns wait in an
+ * overflow bucket, checked once every 64^4 turns.
+ *
+ * Timers expiring on the same turn are reported in scheduling order.
+ */
+template<typename T>
+class TimingWheel final {
+    static constexpr std::uint32_t s_slot_bits = 6;
+    static constexpr std::uint32_t s_slot_count = 1u << s_slot_bits;
+    static constexpr std::uint32_t s_level_count = 4;
+    static constexpr std::uint32_t s_overflow_bucket = s_level_count * s_slot_count;
+
+    /**
+     * Timer: value, due turn, scheduling sequence, bucket and links in the bucket
+     */
+    struct Timer {
+        T m_value = T();
+        std::uint64_t m_due = 0;
+        std::uint64_t m_sequence = 0;
+        std::uint32_t m_bucket = 0;
+        SlotHandle m_previous = SlotMap<Timer>::s_invalid_handle;
+        SlotHandle m_next = SlotMap<Timer>::s_invalid_handle;
+    };
+
+    /**
+     * Timer storage, handles are the timer IDs
+     */
+    SlotMap<Timer> m_timers;
+
+    /**
+     * First timer of each bucket (levels, then overflow)
+     */
+    std::array<SlotHandle, s_overflow_bucket + 1> m_buckets{};
+
+    /**
+     * Last turn processed
+     */
+    std::uint64_t m_now = 0;
+
+    /**
+     * Scheduling counter (expiry order of the timers of a turn)
+     */
+    std::uint64_t m_sequence = 0;
+
+    /**
+     * Timers of the turn being expired (kept to reuse the allocation)
+     */
+    std::vector<Timer> m_expired;
+
+public:
+    /**
+     * Schedule a value.
+     * @param p_due Due turn, at least the next turn
+     * @param p_value Value
+     * @return timer handle
+     */
+    SlotHandle schedule(const std::uint64_t p_due, const T& p_value) {
+        Timer l_timer;
+        l_timer.m_value = p_value;
+        l_timer.m_due = std::max(p_due, m_now + 1);
+        l_timer.m_sequence = m_sequence++;
+        const SlotHandle l_handle = m_timers.insert(l_timer);
+        link(l_handle);
+        return l_handle;
+    }
+
+    /**
+     * Cancel a timer.
+     * @param p_handle Timer handle
+     * @return false if the timer already expired or was cancelled
+     */
+    bool cancel(const SlotHandle p_handle) {
+        if (!m_timers.contains(p_handle)) {
+            return false;
+        }
+        unlink(p_handle);
+        m_timers.erase(p_handle);
+        return true;
+    }
+
+    /**
+     * Advance to a turn, expiring the timers due until then.
+     * @param p_turn Turn
+     * @param p_expired Function called with each expired value (T&), may schedule timers
+     */
+    template<typename F>
+    void advance(const std::uint64_t p_turn, F&& p_expired) {
+        while (m_now < p_turn) {
+            // Nothing scheduled: jump
+            if (m_timers.size() == 0) {
+                m_now = p_turn;
+                return;
+            }
+            ++m_now;
+            cascade();
+
+            // Level 0 bucket: all its timers are due now
+            SlotHandle l_handle = m_buckets[m_now & (s_slot_count - 1)];
+            m_buckets[m_now & (s_slot_count - 1)] = SlotMap<Timer>::s_invalid_handle;
+            while (l_handle != SlotMap<Timer>::s_invalid_handle) {
+                Timer* l_timer = m_timers.get(l_handle);
+                const SlotHandle l_next = l_timer->m_next;
+                m_expired.push_back(std::move(*l_timer));
+                m_timers.erase(l_handle);
+                l_handle = l_next;
+            }
+            std::sort(m_expired.begin(), m_expired.end(), [](const Timer& p_left, const Timer& p_right) {
+                return p_left.m_sequence < p_right.m_sequence;
+            });
+            for (Timer& l_timer: m_expired) {
+                p_expired(l_timer.m_value);
+            }
+            m_expired.clear();
+        }
+    }
+
+    /**
+     * Number of pending timers.
+     * @return number of timers
+     */
+    [[nodiscard]] std::size_t size() const {
+        return m_timers.size();
+    }
+
+    /**
+     * Last turn processed.
+     * @return turn
+     */
+    [[nodiscard]] std::uint64_t get_now() const {
+        return m_now;
+    }
+
+private:
+    /**
+     * Bucket of a due turn, relative to the current turn.
+     * @param p_due Due turn (>= now)
+     * @return bucket index
+     */
+    [[nodiscard]] std::uint32_t bucket_of(const std::uint64_t p_due) const {
+        // Highest bit that differs from now gives the level
+        const std::uint64_t l_difference = p_due ^ m_now;
+        const std::uint32_t l_level = l_difference == 0 ? 0 : static_cast<std::uint32_t>(std::bit_width(l_difference) - 1) / s_slot_bits;
+        if (l_level >= s_level_count) {
+            return s_overflow_bucket;
+        }
+        return l_level * s_slot_count + static_cast<std::uint32_t>((p_due >> (l_level * s_slot_bits)) & (s_slot_count - 1));
+    }
+
+    void link(const SlotHandle p_handle) {
+        Timer* l_timer = m_timers.get(p_handle);
+        l_timer->m_bucket = bucket_of(l_timer->m_due);
+        SlotHandle& l_head = m_buckets[l_timer->m_bucket];
+        l_timer->m_previous = SlotMap<Timer>::s_invalid_handle;
+        l_timer->m_next = l_head;
+        if (l_head != SlotMap<Timer>::s_invalid_handle) {
+            m_timers.get(l_head)->m_previous = p_handle;
+        }
+        l_head = p_handle;
+    }
+
+    void unlink(const SlotHandle p_handle) {
+        Timer* l_timer = m_timers.get(p_handle);
+        if (l_timer->m_previous != SlotMap<Timer>::s_invalid_handle) {
+            m_timers.get(l_timer->m_previous)->m_next = l_timer->m_next;
+        } else {
+            m_buckets[l_timer->m_bucket] = l_timer->m_next;
+        }
+        if (l_timer->m_next != SlotMap<Timer>::s_invalid_handle) {
+            m_timers.get(l_timer->m_next)->m_previous = l_timer->m_previous;
+        }
+    }
+
+    /**
+     * Move the timers of the buckets starting at the current turn to lower levels,
+     * highest level first (a timer may go down several levels).
+     */
+    void cascade() {
+        for (std::uint32_t l_level = s_level_count; l_level > 0; --l_level) {
+            const std::uint64_t l_span_mask = (std::uint64_t(1) << (l_level * s_slot_bits)) - 1;
+            if ((m_now & l_span_mask) != 0) {
+                continue;
+            }
+            const std::uint32_t l_bucket = l_level == s_level_count
+                    ? s_overflow_bucket
+                    : l_level * s_slot_count + static_cast<std::uint32_t>((m_now >> (l_level * s_slot_bits)) & (s_slot_count - 1));
+            SlotHandle l_handle = m_buckets[l_bucket];
+            m_buckets[l_bucket] = SlotMap<Timer>::s_invalid_handle;
+            while (l_handle != SlotMap<Timer>::s_invalid_handle) {
+                const SlotHandle l_next = m_timers.get(l_handle)->m_next;
+                link(l_handle);
+                l_handle = l_next;
+            }
+        }
+    }
+};
@@ -0,0 +1,222 @@
+/**************************************************************************
+ *                                                                        *
+ *  Description: MinimalAgent multi-agent framework                       *
+ *  Website:     https://github.com/jferdelyi/MinimalAgent                *
+ *  Copyright:   (c) 2023-Today, Jean-François Erdelyi                    *
+ *                                                                        *
+ *  CPP version of ActressMAS by Florin Leon                              *
+ *  https://github.com/florinleon/ActressMas                              *
+ *                                                                        *
+ *  This program is free software; you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General License as published by         *
+ *  the Free Software Foundation. This program is distributed in the      *
+ *  hope that it will be useful, but WITHOUT ANY WARRANTY; without even   *
+ *  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR   *
+ *  PURPOSE. See the GNU General License for more details.                *
+ *                                                                        *
+ **************************************************************************/
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "MPSCQueue.hpp"
+
+/**
+ * Wake list: the agents published, swapped and scheduled in a turn, sorted by
+ * schedule index (unique per agent, given at registration).
+ *
+ * An agent joins the list on its first wake-up (message, timer, wake, any thread,
+ * through a lock-free queue) and its "listed" flag keeps it there at most once. A
+ * message-driven agent leaves it when it consumes its wake-ups, the others stay on
+ * it. Stopped agents are listed too, so the dead sweep only visits the list.
+ *
+ * T provides get_schedule_index(), is_listed(), is_dead() and take_wake_up() (see
+ * GDAgent). Only list may be called from any thread, the rest from the environment
+ * thread. Once reserved for the agent count, a turn does not allocate.
+ */
+template<typename T>
+class WakeList final {
+    /**
+     * Listed agents, sorted by schedule index between two turns
+     */
+    std::vector<T*> m_agents;
+
+    /**
+     * Agents woken since the last drain (any thread)
+     */
+    MPSCQueue<T*> m_woken;
+
+    /**
+     * Sequential: agents woken ahead of the running one (min-heap on the schedule
+     * index), agents listed for the next turn
+     */
+    std::vector<T*> m_late;
+    std::vector<T*> m_next_turn;
+
+    static bool is_after(const T* p_left, const T* p_right) {
+        return p_left->get_schedule_index() > p_right->get_schedule_index();
+    }
+
+public:
+    /**
+     * List a woken agent (any thread), the caller just set its listed flag.
+     * @param p_agent Agent
+     */
+    void list(T* p_agent) {
+        m_woken.enqueue(p_agent);
+    }
+
+    /**
+     * List an agent from the environment thread (registration, event), the caller
+     * just set its listed flag. Out of order agents are sorted by the next drain.
+     * @param p_agent Agent
+     */
+    void push_back(T* p_agent) {
+        m_agents.push_back(p_agent);
+    }
+
+    /**
+     * Reserve room for p_count agents: listed and woken in a turn (queue nodes for
+     * every agent in flight and as many kept by the thread free lists).
+     * @param p_count Agents
+     */
+    void reserve(const std::size_t p_count) {
+        m_agents.reserve(p_count);
+        m_late.reserve(p_count);
+        m_next_turn.reserve(p_count);
+        MPSCQueue<T*>::reserve(2 * p_count);
+    }
+
+    /**
+     * Turn start: drop the agents that consumed their wake-ups and were not woken
+     * since (dead ones stay for the sweep), then drain.
+     */
+    void begin_turn() {
+        std::erase_if(m_agents, [](const T* p_agent) {
+            return !p_agent->is_listed() && !p_agent->is_dead();
+        });
+        drain();
+    }
+
+    /**
+     * Move the woken agents to the list, sorted by schedule index without duplicates.
+     */
+    void drain() {
+        T* l_agent = nullptr;
+        while (m_woken.dequeue(l_agent)) {
+            m_agents.push_back(l_agent);
+        }
+
+        // Appended out of order: equal neighbors are the same agent
+        const auto l_is_unordered = [](const T* p_left, const T* p_right) {
+            return p_left->get_schedule_index() >= p_right->get_schedule_index();
+        };
+        if (std::adjacent_find(m_agents.begin(), m_agents.end(), l_is_unordered) != m_agents.end()) {
+            std::sort(m_agents.begin(), m_agents.end(), [](const T* p_left, const T* p_right) {
+                return p_left->get_schedule_index() < p_right->get_schedule_index();
+            });
+            m_agents.erase(std::unique(m_agents.begin(), m_agents.end()), m_agents.end());
+        }
+    }
+
+    /**
+     * Remove the dead agents (after drain).
+     * @param p_remove Called on each dead agent, once removed from the list
+     * @return number of removed agents
+     */
+    template<typename F>
+    std::size_t sweep(F&& p_remove) {
+        std::size_t l_removed = 0;
+        std::erase_if(m_agents, [&p_remove, &l_removed](T* p_agent) {
+            if (!p_agent->is_dead()) {
+                return false;
+            }
+            p_remove(p_agent);
+            ++l_removed;
+            return true;
+        });
+        return l_removed;
+    }
+
+    /**
+     * The agents to run this turn, in schedule order (consumes their wake-ups).
+     * @param p_scheduled Output (cleared)
+     */
+    void schedule(std::vector<T*>& p_scheduled) {
+        p_scheduled.clear();
+        for (T* l_agent: m_agents) {
+            if (!l_agent->is_dead() && l_agent->take_wake_up()) {
+                p_scheduled.push_back(l_agent);
+            }
+        }
+    }
+
+    /**
+     * Sequential: run the listed agents in schedule order, and the agents woken
+     * ahead of the running one in the same turn. The wake-ups are consumed just
+     * before running, the others are listed for the next turn.
+     * @param p_run Called on each agent to run
+     */
+    template<typename F>
+    void run_in_order(F&& p_run) {
+        std::size_t l_next = 0;
+        const std::size_t l_listed_count = m_agents.size();
+        for (;;) {
+            // Next in schedule order: from the list or woken earlier in the turn
+            T* l_agent = nullptr;
+            bool l_is_late = false;
+            if (!m_late.empty() && (l_next == l_listed_count || is_after(m_agents[l_next], m_late.front()))) {
+                std::pop_heap(m_late.begin(), m_late.end(), is_after);
+                l_agent = m_late.back();
+                m_late.pop_back();
+                l_is_late = true;
+            } else if (l_next < l_listed_count) {
+                l_agent = m_agents[l_next++];
+            } else {
+                break;
+            }
+
+            if (!l_agent->is_dead() && l_agent->take_wake_up()) {
+                p_run(l_agent);
+            }
+
+            // Still listed (dead, not message-driven): kept for the next turn
+            if (l_is_late && l_agent->is_listed()) {
+                m_next_turn.push_back(l_agent);
+            }
+
+            // Woken by this run: later this turn if ahead, else at the next turn
+            T* l_woken = nullptr;
+            while (m_woken.dequeue(l_woken)) {
+                if (l_woken->get_schedule_index() > l_agent->get_schedule_index()) {
+                    m_late.push_back(l_woken);
+                    std::push_heap(m_late.begin(), m_late.end(), is_after);
+                } else {
+                    m_next_turn.push_back(l_woken);
+                }
+            }
+        }
+        m_agents.insert(m_agents.end(), m_next_turn.begin(), m_next_turn.end());
+        m_next_turn.clear();
+    }
+
+    [[nodiscard]] std::size_t size() const {
+        return m_agents.size();
+    }
+
+    [[nodiscard]] T* operator[](const std::size_t p_index) const {
+        return m_agents[p_index];
+    }
+
+    [[nodiscard]] typename std::vector<T*>::const_iterator begin() const {
+        return m_agents.begin();
+    }
+
+    [[nodiscard]] typename std::vector<T*>::const_iterator end() const {
+        return m_agents.end();
+    }
+};
@@ -8,6 +8,7 @@
 
 #include "GDAgent.h"
 #include "GDEnvironment.h"
+#include "GDGridEnvironment.h"
 
 using namespace godot;
 
@@ -15,13 +16,17 @@ void initialize_gdcppactressmas_module(ModuleInitializationLevel p_level) {
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) {
 		return;
 	}
+	GDAgent::initialize_hook_names();
 	ClassDB::register_class<GDAgent>();
 	ClassDB::register_class<GDEnvironment>();
+	ClassDB::register_class<GDGridEnvironment>();
 }
 
 void uninitialize_gdcppactressmas_module(ModuleInitializationLevel p_level) {
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) {
+		return;
 	}
+	GDAgent::release_hook_names();
 }
 
 extern "C" {
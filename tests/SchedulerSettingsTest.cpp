@@ -0,0 +1,111 @@
+/**************************************************************************
+ *                                                                        *
+ *  Description: MinimalAgent multi-agent framework                       *
+ *  Website:     https://github.com/jferdelyi/MinimalAgent                *
+ *  Copyright:   (c) 2023-Today, Jean-François Erdelyi                    *
+ *                                                                        *
+ *  CPP version of ActressMAS by Florin Leon                              *
+ *  https://github.com/florinleon/ActressMas                              *
+ *                                                                        *
+ *  This program is free software; you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General License as published by         *
+ *  the Free Software Foundation. This program is distributed in the      *
+ *  hope that it will be useful, but WITHOUT ANY WARRANTY; without even   *
+ *  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR   *
+ *  PURPOSE. See the GNU General License for more details.                *
+ *                                                                        *
+ **************************************************************************/
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "TaskScheduler.h"
+
+/**
+ * Settings changed while jobs run: from a chunk of the running job (must not
+ * deadlock) and from another thread (the worker indices of a job must stay below
+ * the worker count given to the prepare function).
+ */
+
+namespace {
+    constexpr size_t s_count = 4096;
+    constexpr size_t s_grain = 8;
+    constexpr int s_job_count = 500;
+
+    int fail(const char* p_message) {
+        std::fprintf(stderr, "FAILED: %s\n", p_message);
+        return EXIT_FAILURE;
+    }
+
+    /**
+     * Run one job, check every chunk runs on a worker below the prepared count.
+     * @return false if a worker index was out of range
+     */
+    bool run_checked_job(TaskScheduler& p_scheduler, const TaskScheduler::RangeFunction& p_extra = nullptr) {
+        std::atomic<size_t> l_prepared = 0;
+        std::atomic<bool> l_is_in_range = true;
+        std::atomic<size_t> l_processed = 0;
+        p_scheduler.parallel_for(s_count, s_grain, [&](const size_t p_begin, const size_t p_end) {
+            if (TaskScheduler::get_current_worker() >= l_prepared.load(std::memory_order_relaxed)) {
+                l_is_in_range.store(false, std::memory_order_relaxed);
+            }
+            if (p_extra) {
+                p_extra(p_begin, p_end);
+            }
+            l_processed.fetch_add(p_end - p_begin, std::memory_order_relaxed);
+        }, 0, [&l_prepared](const size_t p_workers) {
+            l_prepared.store(p_workers, std::memory_order_relaxed);
+        });
+        return l_is_in_range.load(std::memory_order_relaxed) && l_processed.load(std::memory_order_relaxed) == s_count;
+    }
+}
+
+int main() {
+    TaskScheduler l_scheduler(TaskScheduler::Settings{4});
+
+    // From a chunk of the running job: queued, applied before the next job
+    std::atomic<bool> l_is_configured = false;
+    const bool l_is_first_ok = run_checked_job(l_scheduler, [&l_scheduler, &l_is_configured](size_t, size_t) {
+        if (!l_is_configured.exchange(true)) {
+            TaskScheduler::Settings l_settings = l_scheduler.get_settings();
+            l_settings.m_worker_count = 2;
+            l_scheduler.configure(l_settings);
+        }
+    });
+    if (!l_is_first_ok) {
+        return fail("worker outside the job while configuring from a chunk");
+    }
+    if (l_scheduler.get_settings().m_worker_count != 2) {
+        return fail("queued settings are not reported");
+    }
+    if (!run_checked_job(l_scheduler) || l_scheduler.get_worker_count() != 2) {
+        return fail("queued settings not applied by the next job");
+    }
+
+    // From another thread while jobs run
+    std::atomic<bool> l_is_done = false;
+    std::thread l_configurer([&l_scheduler, &l_is_done] {
+        size_t l_worker_count = 2;
+        while (!l_is_done.load(std::memory_order_relaxed)) {
+            TaskScheduler::Settings l_settings = l_scheduler.get_settings();
+            l_worker_count = l_worker_count == 2 ? 6 : 2;
+            l_settings.m_worker_count = l_worker_count;
+            l_scheduler.configure(l_settings);
+            std::this_thread::yield();
+        }
+    });
+    bool l_is_ok = true;
+    for (int l_job = 0; l_is_ok && l_job < s_job_count; ++l_job) {
+        l_is_ok = run_checked_job(l_scheduler);
+    }
+    l_is_done.store(true, std::memory_order_relaxed);
+    l_configurer.join();
+    if (!l_is_ok) {
+        return fail("worker outside the job while configuring from another thread");
+    }
+
+    std::printf("%d jobs with concurrent settings changes\n", s_job_count);
+    return EXIT_SUCCESS;
+}
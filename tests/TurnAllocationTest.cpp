@@ -0,0 +1,386 @@
+/**************************************************************************
+ *                                                                        *
+ *  Description: MinimalAgent multi-agent framework                       *
+ *  Website:     https://github.com/jferdelyi/MinimalAgent                *
+ *  Copyright:   (c) 2023-Today, Jean-François Erdelyi                    *
+ *                                                                        *
+ *  CPP version of ActressMAS by Florin Leon                              *
+ *  https://github.com/florinleon/ActressMas                              *
+ *                                                                        *
+ *  This program is free software; you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General License as published by         *
+ *  the Free Software Foundation. This program is distributed in the      *
+ *  hope that it will be useful, but WITHOUT ANY WARRANTY; without even   *
+ *  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR   *
+ *  PURPOSE. See the GNU General License for more details.                *
+ *                                                                        *
+ **************************************************************************/
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "IntentBuffer.hpp"
+#include "SlotMap.hpp"
+#include "SpatialHash.hpp"
+#include "TaskScheduler.h"
+#include "WakeList.hpp"
+
+/**
+ * Warm turns of the turn loop bookkeeping must not allocate. Each turn does what
+ * GDEnvironment::run_turn does around the agents, without Godot:
+ * - wake list: turn start, dead sweep, re-registration, scheduling (or in order
+ *   runs with the agents woken during the turn),
+ * - agents run in chunks of TaskScheduler::parallel_for, record an intent, wake
+ *   two agents (any thread) and sometimes stop,
+ * - intents drained in stamp order, then applied as spatial index moves that empty
+ *   and refill cells.
+ * Every operator new is counted while the measure is on. Not covered: the Godot
+ * side of a turn (scripts, published observables Dictionary, signals).
+ */
+
+namespace {
+    std::atomic<bool> s_is_counting = false;
+    std::atomic<uint64_t> s_allocations = 0;
+
+    void* allocate(const std::size_t p_size, const std::size_t p_alignment) {
+        if (s_is_counting.load(std::memory_order_relaxed)) {
+            s_allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+        void* l_pointer = nullptr;
+        if (p_alignment <= alignof(std::max_align_t)) {
+            l_pointer = std::malloc(p_size == 0 ? 1 : p_size);
+        } else {
+            // aligned_alloc wants a multiple of the alignment
+            l_pointer = std::aligned_alloc(p_alignment, (p_size + p_alignment - 1) / p_alignment * p_alignment);
+        }
+        if (!l_pointer) {
+            throw std::bad_alloc();
+        }
+        return l_pointer;
+    }
+
+    /**
+     * Message-driven agent, same wake-up protocol as GDAgent
+     */
+    struct Agent {
+        uint32_t m_index = 0;
+        uint32_t m_schedule_index = 0;
+        SlotHandle m_handle = 0;
+        bool m_is_setup = false;
+        std::atomic<bool> m_is_dead = false;
+        std::atomic<bool> m_is_listed = false;
+        std::atomic<uint8_t> m_wake_reasons = 0;
+
+        [[nodiscard]] uint32_t get_schedule_index() const {
+            return m_schedule_index;
+        }
+
+        [[nodiscard]] bool is_listed() const {
+            return m_is_listed.load();
+        }
+
+        [[nodiscard]] bool is_dead() const {
+            return m_is_dead.load(std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] bool mark_listed() {
+            return !m_is_listed.exchange(true);
+        }
+
+        [[nodiscard]] bool take_wake_up() {
+            m_is_listed.store(false);
+            return m_wake_reasons.exchange(0) != 0 || !m_is_setup;
+        }
+
+        void wake(WakeList<Agent>& p_wake_list) {
+            m_wake_reasons.fetch_or(1);
+            if (!m_is_listed.load() && mark_listed()) {
+                p_wake_list.list(this);
+            }
+        }
+
+        void stop(WakeList<Agent>& p_wake_list) {
+            m_is_dead.store(true);
+            if (mark_listed()) {
+                p_wake_list.list(this);
+            }
+        }
+    };
+
+    /**
+     * Intent recorded by each agent run (what an agent would ask for)
+     */
+    struct Command {
+        uint32_t m_index = 0;
+        float m_x = 0.0f;
+    };
+
+    constexpr size_t s_agent_count = 10000;
+    constexpr size_t s_grain = 16;
+    constexpr size_t s_worker_count = 4;
+    constexpr float s_cell_size = 8.0f;
+    constexpr int s_measured_turns = 200;
+    constexpr int s_warm_turns = 50;
+    constexpr int s_max_warm_up_turns = 10000;
+
+    /**
+     * Agents woken by an agent at a turn
+     */
+    uint32_t first_target(const uint32_t p_index, const int p_turn) {
+        return static_cast<uint32_t>((p_index * 31u + static_cast<uint32_t>(p_turn)) % s_agent_count);
+    }
+    uint32_t second_target(const uint32_t p_index, const int p_turn) {
+        return static_cast<uint32_t>((p_index * 17u + 7u * static_cast<uint32_t>(p_turn) + 1u) % s_agent_count);
+    }
+
+    /**
+     * Agents stopping themselves at a turn
+     */
+    bool is_stopping(const uint32_t p_index, const int p_turn) {
+        return (p_index + static_cast<uint32_t>(p_turn)) % 97u == 0;
+    }
+
+    int fail(const char* p_message) {
+        std::fprintf(stderr, "FAILED: %s\n", p_message);
+        return EXIT_FAILURE;
+    }
+
+    /**
+     * Environment side of the turns
+     */
+    class Turns {
+        TaskScheduler m_scheduler = TaskScheduler(TaskScheduler::Settings{s_worker_count});
+        std::vector<Agent> m_agents = std::vector<Agent>(s_agent_count);
+        SlotMap<uint32_t> m_registry = SlotMap<uint32_t>();
+        SpatialHash m_spatial_index = SpatialHash(s_cell_size);
+        WakeList<Agent> m_wake_list = WakeList<Agent>();
+        std::vector<Agent*> m_scheduled = std::vector<Agent*>();
+        std::vector<Agent*> m_stopped = std::vector<Agent*>();
+        IntentBuffer<Command> m_intents = IntentBuffer<Command>();
+        std::vector<IntentBuffer<Command>::Entry> m_committed = std::vector<IntentBuffer<Command>::Entry>();
+        std::vector<uint8_t> m_is_expected = std::vector<uint8_t>(s_agent_count, 0);
+        std::vector<uint8_t> m_is_woken_in_order = std::vector<uint8_t>(s_agent_count, 0);
+        std::vector<std::atomic<bool>> m_has_run = std::vector<std::atomic<bool>>(s_worker_count);
+        uint32_t m_schedule_sequence = 0;
+        int m_turn = 0;
+        bool m_is_ok = true;
+
+    public:
+        Turns() {
+            for (uint32_t l_index = 0; l_index < s_agent_count; ++l_index) {
+                m_agents[l_index].m_index = l_index;
+                add(m_agents[l_index]);
+            }
+        }
+
+        void reserve() {
+            m_wake_list.reserve(s_agent_count);
+            m_scheduled.reserve(s_agent_count);
+            m_stopped.reserve(s_agent_count);
+            m_intents.reserve(s_agent_count);
+            m_committed.reserve(s_agent_count);
+        }
+
+        [[nodiscard]] bool is_ok() const {
+            return m_is_ok;
+        }
+
+        /**
+         * True once every worker ran a chunk
+         */
+        [[nodiscard]] bool has_every_worker_run() const {
+            for (const std::atomic<bool>& l_flag: m_has_run) {
+                if (!l_flag.load(std::memory_order_relaxed)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void run() {
+            m_wake_list.begin_turn();
+
+            // Dead agents come back as new agents (same storage, new handle and schedule index)
+            m_stopped.clear();
+            m_wake_list.sweep([this](Agent* p_agent) {
+                m_registry.erase(p_agent->m_handle);
+                m_spatial_index.erase(p_agent->m_handle);
+                m_stopped.push_back(p_agent);
+            });
+            for (Agent* l_agent: m_stopped) {
+                add(*l_agent);
+            }
+
+            // Only the woken and new agents are visited
+            for (const Agent* l_agent: m_wake_list) {
+                m_is_ok = m_is_ok && l_agent->is_listed() && !l_agent->is_dead();
+            }
+
+            // Parallel turns, one in order turn out of four (agents woken ahead run in the same turn)
+            if (is_in_order()) {
+                for (uint32_t l_index = 0; l_index < s_agent_count; ++l_index) {
+                    m_is_woken_in_order[l_index] = 0;
+                }
+                m_wake_list.run_in_order([this](Agent* p_agent) {
+                    check_expected(*p_agent);
+                    run_agent(*p_agent);
+                });
+            } else {
+                m_wake_list.schedule(m_scheduled);
+                for (size_t l_index = 1; l_index < m_scheduled.size(); ++l_index) {
+                    m_is_ok = m_is_ok && m_scheduled[l_index - 1]->m_schedule_index < m_scheduled[l_index]->m_schedule_index;
+                }
+                for (Agent* l_agent: m_scheduled) {
+                    check_expected(*l_agent);
+                }
+                m_scheduler.parallel_for(m_scheduled.size(), s_grain, [this](const size_t p_begin, const size_t p_end) {
+                    m_has_run[TaskScheduler::get_current_worker()].store(true, std::memory_order_relaxed);
+                    for (size_t l_index = p_begin; l_index < p_end; ++l_index) {
+                        run_agent(*m_scheduled[l_index]);
+                    }
+                });
+            }
+
+            // Apply the intents in stamp order
+            m_intents.drain(m_committed);
+            for (size_t l_index = 1; l_index < m_committed.size(); ++l_index) {
+                m_is_ok = m_is_ok && m_committed[l_index - 1].m_order < m_committed[l_index].m_order;
+            }
+            for (const auto& l_entry: m_committed) {
+                const Agent& l_agent = m_agents[l_entry.m_command.m_index];
+                if (!l_agent.is_dead()) {
+                    m_spatial_index.move(l_agent.m_handle, l_entry.m_command.m_x, 0.0f);
+                }
+            }
+
+            // Expected at the next turn: woken agents and new agents
+            for (uint32_t l_index = 0; l_index < s_agent_count; ++l_index) {
+                m_is_expected[l_index] = 0;
+            }
+            for (const auto& l_entry: m_committed) {
+                const uint32_t l_index = l_entry.m_command.m_index;
+                m_is_expected[first_target(l_index, m_turn)] = 1;
+                m_is_expected[second_target(l_index, m_turn)] = 1;
+                if (is_stopping(l_index, m_turn)) {
+                    m_is_expected[l_index] = 1;
+                }
+            }
+            m_committed.clear();
+            ++m_turn;
+        }
+
+    private:
+        [[nodiscard]] bool is_in_order() const {
+            return m_turn % 4 == 3;
+        }
+
+        void add(Agent& p_agent) {
+            p_agent.m_handle = m_registry.insert(p_agent.m_index);
+            p_agent.m_schedule_index = m_schedule_sequence++;
+            p_agent.m_is_setup = false;
+            p_agent.m_is_dead.store(false);
+            p_agent.m_is_listed.store(false);
+            p_agent.m_wake_reasons.store(0);
+            m_spatial_index.move(p_agent.m_handle, static_cast<float>(p_agent.m_index) * s_cell_size, 0.0f);
+            if (p_agent.mark_listed()) {
+                m_wake_list.push_back(&p_agent);
+            }
+        }
+
+        /**
+         * An agent runs only if it was woken or is new
+         */
+        void check_expected(const Agent& p_agent) {
+            const bool l_is_woken = m_is_expected[p_agent.m_index] != 0 || (is_in_order() && m_is_woken_in_order[p_agent.m_index] != 0);
+            m_is_ok = m_is_ok && (m_turn == 0 || l_is_woken);
+        }
+
+        void run_agent(Agent& p_agent) {
+            p_agent.m_is_setup = true;
+            const uint64_t l_order = static_cast<uint64_t>(p_agent.m_schedule_index) << 32;
+            // One agent per cell: its old cell is emptied, its new cell created
+            const float l_x = static_cast<float>(p_agent.m_index + (m_turn % 2 == 0 ? s_agent_count : 0)) * s_cell_size;
+            m_intents.record(l_order, {p_agent.m_index, l_x});
+            m_agents[first_target(p_agent.m_index, m_turn)].wake(m_wake_list);
+            m_agents[second_target(p_agent.m_index, m_turn)].wake(m_wake_list);
+            if (is_in_order()) {
+                m_is_woken_in_order[first_target(p_agent.m_index, m_turn)] = 1;
+                m_is_woken_in_order[second_target(p_agent.m_index, m_turn)] = 1;
+            }
+            if (is_stopping(p_agent.m_index, m_turn)) {
+                p_agent.stop(m_wake_list);
+            }
+        }
+    };
+}
+
+void* operator new(const std::size_t p_size) {
+    return allocate(p_size, alignof(std::max_align_t));
+}
+
+void* operator new(const std::size_t p_size, const std::align_val_t p_alignment) {
+    return allocate(p_size, static_cast<std::size_t>(p_alignment));
+}
+
+void operator delete(void* p_pointer) noexcept {
+    std::free(p_pointer);
+}
+
+void operator delete(void* p_pointer, std::size_t) noexcept {
+    std::free(p_pointer);
+}
+
+void operator delete(void* p_pointer, std::align_val_t) noexcept {
+    std::free(p_pointer);
+}
+
+void operator delete(void* p_pointer, std::size_t, std::align_val_t) noexcept {
+    std::free(p_pointer);
+}
+
+int main() {
+    Turns l_turns;
+
+    // Warm up until every worker ran a chunk, then reserve each buffer for its worst
+    // case (one thread running every agent, every agent woken), then until a run of
+    // turns without allocation
+    int l_warm_up_turns = 0;
+    int l_quiet_turns = 0;
+    bool l_is_reserved = false;
+    while (l_quiet_turns < s_warm_turns && l_warm_up_turns++ < s_max_warm_up_turns) {
+        const uint64_t l_before = s_allocations.load(std::memory_order_relaxed);
+        s_is_counting.store(l_is_reserved, std::memory_order_relaxed);
+        l_turns.run();
+        s_is_counting.store(false, std::memory_order_relaxed);
+        l_quiet_turns = l_is_reserved && s_allocations.load(std::memory_order_relaxed) == l_before ? l_quiet_turns + 1 : 0;
+        if (!l_is_reserved && l_turns.has_every_worker_run()) {
+            l_turns.reserve();
+            l_is_reserved = true;
+        }
+    }
+    if (l_quiet_turns < s_warm_turns) {
+        return fail("warm-up turns never stopped allocating");
+    }
+
+    // Measured turns
+    const uint64_t l_before = s_allocations.load(std::memory_order_relaxed);
+    s_is_counting.store(true, std::memory_order_relaxed);
+    for (int l_turn = 0; l_turn < s_measured_turns; ++l_turn) {
+        l_turns.run();
+    }
+    s_is_counting.store(false, std::memory_order_relaxed);
+
+    if (!l_turns.is_ok()) {
+        return fail("wrong scheduling or intent order");
+    }
+    const uint64_t l_allocations = s_allocations.load(std::memory_order_relaxed) - l_before;
+    std::printf("%d warm-up turns, %d measured turns, %llu allocations\n", l_warm_up_turns, s_measured_turns, static_cast<unsigned long long>(l_allocations));
+    if (l_allocations != 0) {
+        return fail("warm turns allocated");
+    }
+    return EXIT_SUCCESS;
+}